@@ -1,17 +1,77 @@
 import json
 import boto3
 import os
+from concurrent.futures import ThreadPoolExecutor
 
 iot_data = boto3.client('iot-data', region_name=os.environ['AWS_REGION'])
 
+def handle_status_report(event):
+    # Invoked by the IoT rule on 'firmware_status/+':
+    #   SELECT *, topic(2) AS mac, 'status_report' AS action FROM 'firmware_status/+'
+    # Clears the device's retained command once it reports running that version,
+    # so reconnects stop re-delivering an update that is already applied.
+    # The same applies to a per-device activate command for a staged release.
+    # A command for a version the device rolled back after its trial boot is cleared
+    # too; the device refuses that version anyway.
+    mac = event.get('mac', '')
+    reported_version = event.get('version', '')
+    health = event.get('health') or {}
+    settled = {reported_version}
+    if health.get('result') == 'rolled_back' and health.get('version'):
+        settled.add(health['version'])
+
+    cleared = []
+    for device_topic in (f'firmware_update/{mac}', f'firmware_activate/{mac}'):
+        try:
+            retained = iot_data.get_retained_message(topic=device_topic)
+            command = json.loads(retained['payload'])
+        except iot_data.exceptions.ResourceNotFoundException:
+            continue
+        except Exception as e:
+            print(f"Failed to read retained command for {device_topic}: {str(e)}")
+            return {'statusCode': 500, 'body': json.dumps('Failed to read retained command')}
+
+        if command.get('version') not in settled:
+            continue
+
+        # Same version, different build; the device will not reinstall it, so only flag it
+        reported_checksum = event.get('checksum')
+        if (command.get('version') == reported_version and reported_checksum and command.get('checksum')
+                and command['checksum'].lower() != reported_checksum.lower()):
+            print(f"{mac} runs {reported_version} with checksum {reported_checksum}, "
+                  f"command expects {command['checksum']}")
+
+        # An empty retained payload deletes the retained message
+        iot_data.publish(topic=device_topic, qos=1, payload=b'', retain=True)
+        cleared.append(device_topic)
+
+    if not cleared:
+        return {'statusCode': 200, 'body': json.dumps('No applied command to clear')}
+    return {'statusCode': 200, 'body': json.dumps(f'Cleared applied command on {", ".join(cleared)}')}
+
+
 def lambda_handler(event, context):
+    if event.get('action') == 'status_report':
+        return handle_status_report(event)
+
     # Extract data
     data = event.get('data', {})
+    if event.get('action') == 'activate':
+        # Devices switch only if they have exactly this version staged
+        return publish_to_topics(json.dumps({"version": data.get('version', '')}),
+                                 data.get('topics') or ['firmware_activate'], 'Activate command')
+
     version = data.get('version', 'unknown-version')
     firmware_url = data.get('firmware_url', '')
+    firmware_urls = data.get('firmware_urls', [])
     signature_url = data.get('signature_url', '')
+    signature = data.get('signature', '')
     checksum = data.get('checksum', '')
-    topic = data.get('topic', '')
+    encryption = data.get('encryption')
+    activation = data.get('activation')
+    rollback = data.get('rollback', False)
+    # One invocation can cover a whole batch of topics (cohorts or per-device)
+    topics = data.get('topics') or [data.get('topic', '')]
 
     # Construct message
     message = {
@@ -20,21 +80,44 @@ def lambda_handler(event, context):
         "signature_url": signature_url,
         "checksum": checksum
     }
+    if signature:
+        # Inline base64 signature lets the device skip the separate signature download
+        message["signature"] = signature
+    if encryption:
+        # {alg, wrapped_key, iv}: the device unwraps the release key with its provisioned KEK
+        message["encryption"] = encryption
+    if len(firmware_urls) > 1:
+        # Ranked mirrors; the device probes them and fails over mid-download
+        message["firmware_urls"] = firmware_urls
+    if activation:
+        # {policy, window}: stage the image and restart later instead of right away
+        message["activation"] = activation
+    if rollback:
+        # Devices install an older version only when the command says it is a rollback
+        message["rollback"] = True
 
-    try:
-        response = iot_data.publish(
-            topic=topic,
-            qos=1,
-            payload=json.dumps(message),
-            retain=True
-        )
-        return {
-            'statusCode': 200,
-            'body': json.dumps(f'OTA command published successfully to topic {topic}')
-        }
-    except Exception as e:
-        print(f"Failed to publish MQTT message: {str(e)}")
+    return publish_to_topics(json.dumps(message), topics, 'OTA command')
+
+
+def publish_to_topics(payload, topics, what):
+    def publish(topic):
+        try:
+            iot_data.publish(topic=topic, qos=1, payload=payload, retain=True)
+            return None
+        except Exception as e:
+            print(f"Failed to publish MQTT message to {topic}: {str(e)}")
+            return topic
+
+    with ThreadPoolExecutor(max_workers=min(16, len(topics))) as pool:
+        failed = [t for t in pool.map(publish, topics) if t]
+
+    if failed:
         return {
             'statusCode': 500,
-            'body': json.dumps('Failed to publish OTA command')
+            'body': json.dumps(f'Failed to publish {what} to {len(failed)}/{len(topics)} topics: {", ".join(failed)}')
         }
+    return {
+        'statusCode': 200,
+        'body': json.dumps(f'{what} published successfully to {len(topics)} topic(s): {", ".join(topics[:5])}'
+                           + (' ...' if len(topics) > 5 else ''))
+    }
@@ -0,0 +1,494 @@
+// Host microbenchmarks for the OTAUpdateManager component.
+//
+// Runs the component's hot paths against the in-memory shims in shims/ and
+// prints one JSON document with a result per benchmark. compare_baselines.py
+// checks that document against baselines.json.
+
+#include "OTAUpdateManager/OTAUpdateManager.h"
+#include "Common/certificates.h"
+#include "Common/CredentialStore.h"
+#include "esp_http_client.h"
+
+#include "mbedtls/aes.h"
+#include "mbedtls/ctr_drbg.h"
+#include "mbedtls/entropy.h"
+#include "mbedtls/md.h"
+#include "mbedtls/nist_kw.h"
+#include "mbedtls/pk.h"
+#include "mbedtls/rsa.h"
+#include "mbedtls/version.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <cstdlib>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+// The benchmark supplies its own credentials instead of linking certificates.cpp.
+const char *AWS_CA_CERT = "";
+const char *IoT_CLIENT_CERT = "";
+const char *IoT_PRIVATE_KEY = "";
+const char *FIRMWARE_SIGN_KEY = "";
+const DerBlob AWS_CA_CERT_DER = {nullptr, 0};
+const DerBlob IoT_CLIENT_CERT_DER = {nullptr, 0};
+const DerBlob IoT_PRIVATE_KEY_DER = {nullptr, 0};
+
+namespace
+{
+
+// Reaches OtaUpdateManager's private parsePayload/isNewVersion without a friend in the
+// production header: access checks do not apply to explicit instantiation arguments.
+template <typename Tag, typename Tag::type Member>
+struct PrivateMember
+{
+    friend typename Tag::type get(Tag) { return Member; }
+};
+
+struct ParsePayloadTag
+{
+    using type = bool (OtaUpdateManager::*)(const std::string &, OtaUpdateManager::FirmwareMetadata &);
+    friend type get(ParsePayloadTag);
+};
+
+struct IsNewVersionTag
+{
+    using type = bool (OtaUpdateManager::*)(const std::string &);
+    friend type get(IsNewVersionTag);
+};
+
+template struct PrivateMember<ParsePayloadTag, &OtaUpdateManager::parsePayload>;
+template struct PrivateMember<IsNewVersionTag, &OtaUpdateManager::isNewVersion>;
+
+struct Result
+{
+    std::string name;
+    double nsPerOp;
+    uint64_t iterations;
+    size_t bytesPerOp;
+};
+
+std::vector<Result> g_results;
+
+// Timed repetitions per benchmark; the median is recorded so one noisy run cannot fail the gate
+constexpr int kRepetitions = 5;
+
+// Runs `op` once as a warm-up, then kRepetitions times until at least `minSeconds` have
+// elapsed each, and records the median of the per-repetition means.
+void run(const std::string &name, size_t bytesPerOp, const std::function<bool()> &op, double minSeconds = 0.1)
+{
+    using clock = std::chrono::steady_clock;
+
+    if (!op())
+    {
+        fprintf(stderr, "benchmark %s: operation failed\n", name.c_str());
+        exit(1);
+    }
+
+    std::vector<double> samples;
+    uint64_t iterations = 0;
+    for (int rep = 0; rep < kRepetitions; ++rep)
+    {
+        uint64_t repIterations = 0;
+        auto start = clock::now();
+        double elapsed = 0;
+        do
+        {
+            op();
+            ++repIterations;
+            elapsed = std::chrono::duration<double>(clock::now() - start).count();
+        } while (elapsed < minSeconds);
+
+        samples.push_back(elapsed * 1e9 / repIterations);
+        iterations += repIterations;
+    }
+
+    std::sort(samples.begin(), samples.end());
+    double median = samples[samples.size() / 2];
+    g_results.push_back({name, median, iterations, bytesPerOp});
+    fprintf(stderr, "%-36s %14.1f ns/op (median of %d, spread %.1f%%)\n", name.c_str(), median, kRepetitions,
+            100.0 * (samples.back() - samples.front()) / median);
+}
+
+std::vector<uint8_t> makeImage(size_t size)
+{
+    std::vector<uint8_t> image(size);
+    uint32_t x = 0x12345678;
+    for (auto &b : image)
+    {
+        x = x * 1664525u + 1013904223u;
+        b = static_cast<uint8_t>(x >> 24);
+    }
+    return image;
+}
+
+std::string toHex(const uint8_t *data, size_t len)
+{
+    std::string out;
+    char byte[3];
+    for (size_t i = 0; i < len; ++i)
+    {
+        snprintf(byte, sizeof(byte), "%02x", data[i]);
+        out += byte;
+    }
+    return out;
+}
+
+// Holds a freshly generated RSA-2048 key and signs images with it.
+class TestSigner
+{
+public:
+    TestSigner()
+    {
+        const char *pers = "ota_bench";
+        mbedtls_pk_init(&pk);
+        mbedtls_entropy_init(&entropy);
+        mbedtls_ctr_drbg_init(&drbg);
+        mbedtls_ctr_drbg_seed(&drbg, mbedtls_entropy_func, &entropy,
+                              reinterpret_cast<const unsigned char *>(pers), strlen(pers));
+        mbedtls_pk_setup(&pk, mbedtls_pk_info_from_type(MBEDTLS_PK_RSA));
+        mbedtls_rsa_gen_key(mbedtls_pk_rsa(pk), mbedtls_ctr_drbg_random, &drbg, 2048, 65537);
+
+        unsigned char pem[1024] = {0};
+        mbedtls_pk_write_pubkey_pem(&pk, pem, sizeof(pem));
+        publicKeyPem = reinterpret_cast<const char *>(pem);
+    }
+
+    ~TestSigner()
+    {
+        mbedtls_pk_free(&pk);
+        mbedtls_ctr_drbg_free(&drbg);
+        mbedtls_entropy_free(&entropy);
+    }
+
+    std::vector<uint8_t> sign(const uint8_t hash[32])
+    {
+        std::vector<uint8_t> sig(MBEDTLS_PK_SIGNATURE_MAX_SIZE);
+        size_t sigLen = 0;
+#if MBEDTLS_VERSION_MAJOR >= 3
+        mbedtls_pk_sign(&pk, MBEDTLS_MD_SHA256, hash, 32, sig.data(), sig.size(), &sigLen,
+                        mbedtls_ctr_drbg_random, &drbg);
+#else
+        mbedtls_pk_sign(&pk, MBEDTLS_MD_SHA256, hash, 32, sig.data(), &sigLen,
+                        mbedtls_ctr_drbg_random, &drbg);
+#endif
+        sig.resize(sigLen);
+        return sig;
+    }
+
+    std::string publicKeyPem;
+
+private:
+    mbedtls_pk_context pk;
+    mbedtls_entropy_context entropy;
+    mbedtls_ctr_drbg_context drbg;
+};
+
+void sha256(const uint8_t *data, size_t len, uint8_t out[32])
+{
+    mbedtls_md(mbedtls_md_info_from_type(MBEDTLS_MD_SHA256), data, len, out);
+}
+
+void benchPayload()
+{
+    OtaUpdateManager manager;
+    const std::string payload =
+        R"({"version":"1.4.2","firmware_url":"https://example.execute-api.eu-north-1.amazonaws.com/prod/firmware/1.4.2",)"
+        R"("signature_url":"https://example-bucket.s3.eu-north-1.amazonaws.com/signatures/1.4.2.sig",)"
+        R"("checksum":"9f86d081884c7d659a2feaa0c55ad015a3bf4f1b2b0b822cd15d6c15b0f00a08"})";
+
+    run("parse_payload", 0, [&]
+        {
+            OtaUpdateManager::FirmwareMetadata meta;
+            return (manager.*get(ParsePayloadTag()))(payload, meta);
+        });
+
+    run("is_new_version", 0, [&]
+        { return (manager.*get(IsNewVersionTag()))("1.4.2"); });
+
+    // Retained command for the version already running: must not start a task.
+    const std::string current = R"({"version":"1.0.0","firmware_url":"https://example/firmware/1.0.0",)"
+                                R"("signature_url":"https://example/1.0.0.sig","checksum":"00"})";
+    run("update_precheck/up_to_date", 0, [&]
+        { return !ota_start_update_task(current.data(), current.size()); });
+}
+
+void benchDownload(const std::vector<uint8_t> &image, const std::vector<uint8_t> &signature)
+{
+    const char *fwUrl = "https://bench/firmware";
+    const char *sigUrl = "https://bench/signature";
+    host_http_serve(fwUrl, image.data(), image.size());
+    host_http_serve(sigUrl, signature.data(), signature.size());
+
+    const esp_partition_t *partition = esp_ota_get_next_update_partition(NULL);
+    for (size_t chunk : {512u, 1024u, 4096u, 16384u})
+    {
+        HttpDownloader downloader(chunk);
+        run("http_download/chunk_" + std::to_string(chunk), image.size(), [&]
+            {
+                esp_ota_handle_t handle = 0;
+                uint32_t size = 0;
+                std::vector<uint8_t> sig;
+                bool ok = downloader.downloadToPartition({fwUrl}, sigUrl, partition, &handle, &size, sig);
+                esp_ota_end(handle);
+                return ok;
+            });
+    }
+
+    // Primary mirror unreachable: cost of the TTFB probe and falling through to the next one
+    HttpDownloader downloader;
+    const std::vector<std::string> mirrors = {"https://bench/missing", fwUrl};
+    run("http_download/mirror_failover", image.size(), [&]
+        {
+            esp_ota_handle_t handle = 0;
+            uint32_t size = 0;
+            std::vector<uint8_t> sig;
+            bool ok = downloader.downloadToPartition(mirrors, sigUrl, partition, &handle, &size, sig);
+            esp_ota_end(handle);
+            return ok;
+        });
+
+    // Latency-bound link (20 ms TTFB, 256 KB/s per connection) and a TTFB-bound one
+    // (150 ms, unthrottled) where the first request must settle on a single stream
+    const struct
+    {
+        const char *name;
+        int64_t ttfbUs;
+        int64_t bytesPerSec;
+    } links[] = {{"latency_bound", 20000, 256 * 1024}, {"ttfb_bound", 150000, 0}};
+    for (const auto &link : links)
+    {
+        host_http_set_link(link.ttfbUs, link.bytesPerSec);
+        for (int connections : {1, 3})
+        {
+            HttpDownloader parallel(1024, connections);
+            run(std::string("http_download_parallel/") + link.name + "_conns_" + std::to_string(connections),
+                image.size(), [&]
+                {
+                    esp_ota_handle_t handle = 0;
+                    uint32_t size = 0;
+                    std::vector<uint8_t> sig;
+                    bool ok = parallel.downloadToPartition({fwUrl}, sigUrl, partition, &handle, &size, sig);
+                    esp_ota_end(handle);
+                    return ok;
+                });
+        }
+    }
+    host_http_set_link(0, 0);
+}
+
+// Encrypts `image` the way ota-pack --encrypt-kek does and provisions the KEK in NVS.
+struct EncryptedImage
+{
+    std::vector<uint8_t> data;
+    std::vector<uint8_t> wrappedKey;
+    std::vector<uint8_t> iv;
+};
+
+EncryptedImage encryptImage(const std::vector<uint8_t> &image)
+{
+    const std::vector<uint8_t> kek(32, 0x4B);
+    const uint8_t releaseKey[32] = {0x11, 0x22, 0x33, 0x44};
+    EncryptedImage out;
+    out.iv.assign(16, 0xC7);
+
+    NVSStorageHandler keys("fw_keys", "keys");
+    keys.beginEncrypted();
+    keys.storeBlob("fw_kek", kek);
+
+    mbedtls_nist_kw_context kw;
+    mbedtls_nist_kw_init(&kw);
+    size_t wrappedLen = 0;
+    out.wrappedKey.resize(sizeof(releaseKey) + 8);
+    mbedtls_nist_kw_setkey(&kw, MBEDTLS_CIPHER_ID_AES, kek.data(), 256, 1);
+    mbedtls_nist_kw_wrap(&kw, MBEDTLS_KW_MODE_KW, releaseKey, sizeof(releaseKey),
+                         out.wrappedKey.data(), &wrappedLen, out.wrappedKey.size());
+    mbedtls_nist_kw_free(&kw);
+    out.wrappedKey.resize(wrappedLen);
+
+    mbedtls_aes_context aes;
+    mbedtls_aes_init(&aes);
+    mbedtls_aes_setkey_enc(&aes, releaseKey, 256);
+    size_t ncOff = 0;
+    uint8_t counter[16], stream[16];
+    memcpy(counter, out.iv.data(), sizeof(counter));
+    out.data.resize(image.size());
+    mbedtls_aes_crypt_ctr(&aes, image.size(), &ncOff, counter, stream, image.data(), out.data.data());
+    mbedtls_aes_free(&aes);
+    return out;
+}
+
+// Same transfer as benchDownload with the decrypt stage in the loop. Host AES is
+// software (or AES-NI); on the device CONFIG_MBEDTLS_HARDWARE_AES moves it to the accelerator.
+void benchDecrypt(const std::vector<uint8_t> &image, const std::vector<uint8_t> &signature)
+{
+    EncryptedImage encrypted = encryptImage(image);
+
+    FirmwareDecryptor decryptor;
+    if (!decryptor.begin(encrypted.wrappedKey, encrypted.iv))
+    {
+        fprintf(stderr, "benchmark decrypt: key unwrap failed\n");
+        exit(1);
+    }
+
+    std::vector<uint8_t> buffer = encrypted.data;
+    run("aes_ctr_decrypt/" + std::to_string(image.size() / 1024) + "k", image.size(), [&]
+        {
+            decryptor.seek(0);
+            return decryptor.decrypt(buffer.data(), buffer.size());
+        });
+
+    const char *fwUrl = "https://bench/firmware.enc";
+    const char *sigUrl = "https://bench/signature";
+    host_http_serve(fwUrl, encrypted.data.data(), encrypted.data.size());
+    host_http_serve(sigUrl, signature.data(), signature.size());
+
+    const esp_partition_t *partition = esp_ota_get_next_update_partition(NULL);
+    for (size_t chunk : {1024u, 4096u, 16384u})
+    {
+        HttpDownloader downloader(chunk);
+        run("http_download_decrypt/chunk_" + std::to_string(chunk), image.size(), [&]
+            {
+                esp_ota_handle_t handle = 0;
+                uint32_t size = 0;
+                std::vector<uint8_t> sig;
+                bool ok = downloader.downloadToPartition({fwUrl}, sigUrl, partition, &handle, &size, sig, &decryptor);
+                esp_ota_end(handle);
+                return ok;
+            });
+    }
+
+    // The partition must hold the plaintext SignatureVerifier hashes
+    std::vector<uint8_t> flashed(image.size());
+    esp_partition_read(partition, 0, flashed.data(), flashed.size());
+    if (flashed != image)
+    {
+        fprintf(stderr, "benchmark decrypt: decrypted image mismatch\n");
+        exit(1);
+    }
+}
+
+void benchVerify(const std::vector<uint8_t> &image, TestSigner &signer)
+{
+    uint8_t hash[32];
+    sha256(image.data(), image.size(), hash);
+    std::vector<uint8_t> signature = signer.sign(hash);
+    std::string checksum = toHex(hash, sizeof(hash));
+
+    const esp_partition_t *partition = esp_ota_get_next_update_partition(NULL);
+    esp_ota_handle_t handle = 0;
+    esp_ota_begin(partition, image.size(), &handle);
+    esp_ota_write(handle, image.data(), image.size());
+    esp_ota_end(handle);
+
+    SignatureVerifier verifier;
+    run("signature_verify/" + std::to_string(image.size() / 1024) + "k", image.size(), [&]
+        { return verifier.verify(partition, image.size(), signature, checksum); });
+}
+
+// Fixed cost verify() pays after hashing, plus the one-time key parse it no longer repeats.
+void benchRsaVerify(TestSigner &signer)
+{
+    uint8_t hash[32] = {0};
+    std::vector<uint8_t> signature = signer.sign(hash);
+
+    run("pk_parse_public_key", 0, [&]
+        {
+            mbedtls_pk_context pk;
+            mbedtls_pk_init(&pk);
+            int ret = mbedtls_pk_parse_public_key(&pk,
+                                                  reinterpret_cast<const uint8_t *>(FIRMWARE_SIGN_KEY),
+                                                  strlen(FIRMWARE_SIGN_KEY) + 1);
+            mbedtls_pk_free(&pk);
+            return ret == 0;
+        });
+
+    std::shared_ptr<mbedtls_pk_context> pk = CredentialStore::instance().firmwareSignKey();
+    run("rsa_verify", 0, [&]
+        {
+            return pk && mbedtls_pk_verify(pk.get(), MBEDTLS_MD_SHA256, hash, sizeof(hash),
+                                           signature.data(), signature.size()) == 0;
+        });
+}
+
+void benchNvs()
+{
+    NVSStorageHandler nvs("nvs", "bench");
+    nvs.begin();
+    nvs.storeFirmwareVersion("1.0.0");
+
+    run("nvs_get_firmware_version", 0, [&]
+        { return nvs.getFirmwareVersion() == "1.0.0"; });
+    run("nvs_store_firmware_version", 0, [&]
+        { return nvs.storeFirmwareVersion("1.0.0"); });
+
+    const std::vector<uint8_t> digest(32, 0x5A);
+    std::vector<uint8_t> out;
+    run("nvs_store_blob", 0, [&]
+        { return nvs.storeBlob("digest", digest); });
+    run("nvs_get_blob", 0, [&]
+        { return nvs.getBlob("digest", out) && out.size() == digest.size(); });
+
+    // Paid by a rollback command before it re-verifies the inactive slot
+    const esp_partition_t *partition = esp_ota_get_next_update_partition(NULL);
+    SlotIndex slots;
+    slots.record(partition, {"1.0.0", 1024 * 1024, std::string(64, 'a'), std::vector<uint8_t>(256, 0xA5)});
+    run("slot_index_holds", 0, [&]
+        { return slots.holds(partition, "1.0.0"); });
+    slots.forget(partition);
+}
+
+void writeJson(FILE *out)
+{
+    fprintf(out, "{\n  \"benchmarks\": [\n");
+    for (size_t i = 0; i < g_results.size(); ++i)
+    {
+        const Result &r = g_results[i];
+        double mbPerSec = r.bytesPerOp ? (r.bytesPerOp / (1024.0 * 1024.0)) / (r.nsPerOp / 1e9) : 0;
+        fprintf(out, "    {\"name\": \"%s\", \"ns_per_op\": %.1f, \"iterations\": %llu, \"mb_per_s\": %.2f}%s\n",
+                r.name.c_str(), r.nsPerOp, static_cast<unsigned long long>(r.iterations), mbPerSec,
+                i + 1 < g_results.size() ? "," : "");
+    }
+    fprintf(out, "  ]\n}\n");
+}
+
+} // namespace
+
+int main(int argc, char **argv)
+{
+    const char *outPath = nullptr;
+    for (int i = 1; i < argc; ++i)
+    {
+        if (strncmp(argv[i], "--out=", 6) == 0)
+            outPath = argv[i] + 6;
+    }
+
+    TestSigner signer;
+    FIRMWARE_SIGN_KEY = signer.publicKeyPem.c_str();
+
+    const std::vector<uint8_t> image = makeImage(1024 * 1024);
+    const std::vector<uint8_t> smallImage = makeImage(64 * 1024);
+    const std::vector<uint8_t> signature(256, 0xA5);
+
+    benchPayload();
+    benchDownload(image, signature);
+    benchDecrypt(image, signature);
+    benchVerify(smallImage, signer);
+    benchVerify(image, signer);
+    benchRsaVerify(signer);
+    benchNvs();
+
+    FILE *out = outPath ? fopen(outPath, "w") : stdout;
+    if (!out)
+    {
+        fprintf(stderr, "Cannot open %s\n", outPath);
+        return 1;
+    }
+    writeJson(out);
+    if (outPath)
+        fclose(out);
+    return 0;
+}
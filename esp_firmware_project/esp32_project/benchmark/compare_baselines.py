@@ -0,0 +1,88 @@
+#!/usr/bin/env python3
+"""Compare ota_bench results against stored baselines.
+
+Usage:
+  compare_baselines.py [--update] [--tolerance=0.15] baselines.json results.json
+
+Exits non-zero if any benchmark is slower than its baseline by more than the
+tolerance, or if a result has no baseline or a baseline has no result: a new or
+renamed benchmark must be recorded with --update. A baseline entry may carry its
+own "tolerance" (a fraction, e.g. 0.3 for the network-simulated downloads);
+entries without one use --tolerance (default 15%). With --update, the results
+are written over the baselines instead, keeping each entry's tolerance.
+"""
+
+import json
+import sys
+
+
+def load(path):
+    with open(path) as f:
+        return {b["name"]: b for b in json.load(f)["benchmarks"]}
+
+
+def main(argv):
+    update = "--update" in argv
+    tolerance = 0.15
+    paths = []
+    for arg in argv:
+        if arg.startswith("--tolerance="):
+            tolerance = float(arg.split("=", 1)[1])
+        elif not arg.startswith("--"):
+            paths.append(arg)
+
+    if len(paths) != 2:
+        print(__doc__)
+        return 2
+
+    baseline_path, results_path = paths
+    results = load(results_path)
+
+    if update:
+        try:
+            previous = load(baseline_path)
+        except FileNotFoundError:
+            previous = {}
+        for name, result in results.items():
+            if "tolerance" in previous.get(name, {}):
+                result["tolerance"] = previous[name]["tolerance"]
+        with open(baseline_path, "w") as f:
+            json.dump({"benchmarks": list(results.values())}, f, indent=2)
+            f.write("\n")
+        print(f"Baselines updated: {baseline_path}")
+        return 0
+
+    baselines = load(baseline_path)
+    regressions = 0
+    unmatched = 0
+    for name, result in results.items():
+        base = baselines.get(name)
+        if base is None:
+            print(f"  NEW   {name}: {result['ns_per_op']:.1f} ns/op (no baseline)")
+            unmatched += 1
+            continue
+        ratio = result["ns_per_op"] / base["ns_per_op"]
+        allowed = base.get("tolerance", tolerance)
+        status = "OK"
+        if ratio > 1.0 + allowed:
+            status = "SLOW"
+            regressions += 1
+        print(f"  {status:<5} {name}: {result['ns_per_op']:.1f} ns/op "
+              f"(baseline {base['ns_per_op']:.1f}, {100.0 * (ratio - 1.0):+.1f}%, allowed +{allowed:.0%})")
+    for name in baselines:
+        if name not in results:
+            print(f"  GONE  {name}: no result")
+            unmatched += 1
+
+    if regressions:
+        print(f"{regressions} benchmark(s) regressed beyond their tolerance")
+    if unmatched:
+        print(f"{unmatched} benchmark(s) without a matching baseline; record them with --update")
+    if regressions or unmatched:
+        return 1
+    print("No regressions")
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main(sys.argv[1:]))
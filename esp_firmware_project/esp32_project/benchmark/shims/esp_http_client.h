@@ -0,0 +1,70 @@
+#pragma once
+// Host shim: requests are answered from bodies registered with
+// host_http_serve(), without any network or TLS. A "Range: bytes=a-b"
+// header is honoured with a 206 response and a Content-Range header event.
+// host_http_set_link() models a latency-bound link per connection.
+
+#include <cstddef>
+#include <cstdint>
+#include "esp_err.h"
+
+typedef enum
+{
+    HTTP_TRANSPORT_UNKNOWN = 0x0,
+    HTTP_TRANSPORT_OVER_TCP,
+    HTTP_TRANSPORT_OVER_SSL,
+} esp_http_client_transport_t;
+
+typedef enum
+{
+    HTTP_EVENT_ERROR = 0,
+    HTTP_EVENT_ON_CONNECTED,
+    HTTP_EVENT_HEADERS_SENT,
+    HTTP_EVENT_ON_HEADER,
+    HTTP_EVENT_ON_DATA,
+    HTTP_EVENT_ON_FINISH,
+    HTTP_EVENT_DISCONNECTED,
+} esp_http_client_event_id_t;
+
+typedef struct host_http_client *esp_http_client_handle_t;
+
+typedef struct
+{
+    esp_http_client_event_id_t event_id;
+    esp_http_client_handle_t client;
+    void *data;
+    int data_len;
+    void *user_data;
+    char *header_key;
+    char *header_value;
+} esp_http_client_event_t;
+
+typedef esp_err_t (*http_event_handle_cb)(esp_http_client_event_t *evt);
+
+typedef struct
+{
+    const char *url;
+    esp_http_client_transport_t transport_type;
+    const char *cert_pem;
+    bool use_global_ca_store;
+    bool disable_auto_redirect;
+    int timeout_ms;
+    int buffer_size;
+    http_event_handle_cb event_handler;
+    void *user_data;
+} esp_http_client_config_t;
+
+esp_http_client_handle_t esp_http_client_init(const esp_http_client_config_t *config);
+esp_err_t esp_http_client_set_header(esp_http_client_handle_t client, const char *key, const char *value);
+esp_err_t esp_http_client_open(esp_http_client_handle_t client, int write_len);
+int64_t esp_http_client_fetch_headers(esp_http_client_handle_t client);
+int esp_http_client_get_status_code(esp_http_client_handle_t client);
+int esp_http_client_read(esp_http_client_handle_t client, char *buffer, int len);
+esp_err_t esp_http_client_close(esp_http_client_handle_t client);
+esp_err_t esp_http_client_cleanup(esp_http_client_handle_t client);
+
+// Registers the body returned for every request to `url`.
+void host_http_serve(const char *url, const uint8_t *body, size_t length);
+
+// Delays every response by ttfbUs and caps each connection at bytesPerSec (0 = unlimited).
+void host_http_set_link(int64_t ttfbUs, int64_t bytesPerSec);
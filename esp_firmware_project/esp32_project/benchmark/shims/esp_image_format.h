@@ -0,0 +1,19 @@
+#pragma once
+// Host shim: image metadata for the in-memory flash behind esp_partition.h.
+
+#include <cstdint>
+#include "esp_err.h"
+
+typedef struct
+{
+    uint32_t offset;
+    uint32_t size;
+} esp_partition_pos_t;
+
+typedef struct
+{
+    uint32_t image_len;
+} esp_image_metadata_t;
+
+// Reports the whole partition as the image; the host flash carries no segment headers
+esp_err_t esp_image_get_metadata(const esp_partition_pos_t *part, esp_image_metadata_t *metadata);
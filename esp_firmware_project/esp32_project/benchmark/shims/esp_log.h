@@ -0,0 +1,14 @@
+#pragma once
+// Host shim: log calls are formatted into a scratch buffer and discarded, so
+// the benchmark still pays the formatting cost the device pays.
+
+#include <cstdarg>
+#include "esp_err.h"
+
+void host_log_discard(const char *tag, const char *format, ...);
+
+#define ESP_LOGE(tag, format, ...) host_log_discard(tag, format, ##__VA_ARGS__)
+#define ESP_LOGW(tag, format, ...) host_log_discard(tag, format, ##__VA_ARGS__)
+#define ESP_LOGI(tag, format, ...) host_log_discard(tag, format, ##__VA_ARGS__)
+#define ESP_LOGD(tag, format, ...) host_log_discard(tag, format, ##__VA_ARGS__)
+#define ESP_LOGV(tag, format, ...) host_log_discard(tag, format, ##__VA_ARGS__)
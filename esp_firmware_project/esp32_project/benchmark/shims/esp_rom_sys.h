@@ -0,0 +1,6 @@
+#pragma once
+// Host shim: reports a fixed CPU clock.
+
+#include <cstdint>
+
+uint32_t esp_rom_get_cpu_ticks_per_us(void);
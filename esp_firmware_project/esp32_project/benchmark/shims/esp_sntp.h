@@ -0,0 +1,9 @@
+#pragma once
+// Host shim: SNTP calls are no-ops; the host clock is already set.
+
+#define ESP_SNTP_OPMODE_POLL 0
+
+bool esp_sntp_enabled(void);
+void esp_sntp_setoperatingmode(int operating_mode);
+void esp_sntp_setservername(unsigned char idx, const char *server);
+void esp_sntp_init(void);
@@ -0,0 +1,8 @@
+#pragma once
+// Host shim: restart is a no-op on the host; free heap is a fixed ESP32-like figure.
+
+#include <cstdint>
+#include "esp_err.h"
+
+void esp_restart(void);
+uint32_t esp_get_free_heap_size(void);
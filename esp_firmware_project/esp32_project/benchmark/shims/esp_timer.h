@@ -0,0 +1,21 @@
+#pragma once
+// Host shim: microseconds from a monotonic clock; timers are created but never fire.
+
+#include <cstdint>
+#include "esp_err.h"
+
+int64_t esp_timer_get_time(void);
+
+typedef struct esp_timer *esp_timer_handle_t;
+typedef void (*esp_timer_cb_t)(void *arg);
+
+typedef struct
+{
+    esp_timer_cb_t callback;
+    void *arg;
+    const char *name;
+} esp_timer_create_args_t;
+
+esp_err_t esp_timer_create(const esp_timer_create_args_t *args, esp_timer_handle_t *out_handle);
+esp_err_t esp_timer_start_periodic(esp_timer_handle_t timer, uint64_t period_us);
+esp_err_t esp_timer_stop(esp_timer_handle_t timer);
@@ -0,0 +1,7 @@
+#pragma once
+// Host shim: the global CA store only records that it was set.
+
+#include "esp_err.h"
+
+esp_err_t esp_tls_init_global_ca_store(void);
+esp_err_t esp_tls_set_global_ca_store(const unsigned char *cacert_pem_buf, const unsigned int cacert_pem_bytes);
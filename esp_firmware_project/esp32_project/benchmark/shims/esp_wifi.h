@@ -0,0 +1,8 @@
+#pragma once
+// Host shim: only the power save calls used by PerformanceProfile.
+
+#include "esp_err.h"
+#include "esp_wifi_types.h"
+
+esp_err_t esp_wifi_set_ps(wifi_ps_type_t type);
+esp_err_t esp_wifi_get_ps(wifi_ps_type_t *type);
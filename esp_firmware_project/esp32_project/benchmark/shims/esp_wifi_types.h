@@ -0,0 +1,9 @@
+#pragma once
+// Host shim: Wi-Fi power save modes.
+
+typedef enum
+{
+    WIFI_PS_NONE,
+    WIFI_PS_MIN_MODEM,
+    WIFI_PS_MAX_MODEM,
+} wifi_ps_type_t;
@@ -0,0 +1,14 @@
+#pragma once
+// Host shim: basic types and tick conversions only.
+
+#include <cstdint>
+
+typedef uint32_t TickType_t;
+typedef int BaseType_t;
+typedef unsigned int UBaseType_t;
+
+#define pdPASS 1
+#define pdFAIL 0
+
+#define portTICK_PERIOD_MS 1
+#define pdMS_TO_TICKS(ms) ((TickType_t)(ms))
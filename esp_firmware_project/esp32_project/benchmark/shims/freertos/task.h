@@ -0,0 +1,15 @@
+#pragma once
+// Host shim: tasks run on detached std::threads; delays and deletes are no-ops.
+
+#include "freertos/FreeRTOS.h"
+
+void vTaskDelay(TickType_t ticks);
+void vTaskDelete(void *task);
+
+typedef void *TaskHandle_t;
+typedef void (*TaskFunction_t)(void *);
+
+#define tskIDLE_PRIORITY 0
+
+BaseType_t xTaskCreate(TaskFunction_t fn, const char *name, uint32_t stack, void *param,
+                       UBaseType_t priority, TaskHandle_t *handle);
@@ -0,0 +1,554 @@
+#include "esp_err.h"
+#include "esp_log.h"
+#include "esp_system.h"
+#include "esp_app_desc.h"
+#include "esp_partition.h"
+#include "esp_image_format.h"
+#include "esp_ota_ops.h"
+#include "esp_http_client.h"
+#include "esp_tls.h"
+#include "esp_timer.h"
+#include "esp_pm.h"
+#include "esp_wifi.h"
+#include "esp_rom_sys.h"
+#include "esp_sntp.h"
+#include "nvs.h"
+#include "nvs_flash.h"
+#include "freertos/task.h"
+
+#include <cstdio>
+#include <cstring>
+#include <map>
+#include <string>
+#include <vector>
+#include <thread>
+#include <algorithm>
+#include <chrono>
+
+// ---- Logging / system ----
+
+const char *esp_err_to_name(esp_err_t code)
+{
+    switch (code)
+    {
+    case ESP_OK:
+        return "ESP_OK";
+    case ESP_ERR_NO_MEM:
+        return "ESP_ERR_NO_MEM";
+    case ESP_ERR_INVALID_ARG:
+        return "ESP_ERR_INVALID_ARG";
+    case ESP_ERR_INVALID_STATE:
+        return "ESP_ERR_INVALID_STATE";
+    case ESP_ERR_INVALID_SIZE:
+        return "ESP_ERR_INVALID_SIZE";
+    case ESP_ERR_NOT_FOUND:
+        return "ESP_ERR_NOT_FOUND";
+    case ESP_ERR_NOT_SUPPORTED:
+        return "ESP_ERR_NOT_SUPPORTED";
+    case ESP_ERR_NVS_NOT_FOUND:
+        return "ESP_ERR_NVS_NOT_FOUND";
+    default:
+        return "ESP_FAIL";
+    }
+}
+
+void host_log_discard(const char *tag, const char *format, ...)
+{
+    char line[256];
+    va_list args;
+    va_start(args, format);
+    vsnprintf(line, sizeof(line), format, args);
+    va_end(args);
+    (void)tag;
+}
+
+void esp_restart(void) {}
+
+uint32_t esp_get_free_heap_size(void)
+{
+    return 200 * 1024;
+}
+
+int64_t esp_timer_get_time(void)
+{
+    using namespace std::chrono;
+    return duration_cast<microseconds>(steady_clock::now().time_since_epoch()).count();
+}
+
+esp_err_t esp_timer_create(const esp_timer_create_args_t *args, esp_timer_handle_t *out_handle)
+{
+    (void)args;
+    static int s_timer;
+    *out_handle = reinterpret_cast<esp_timer_handle_t>(&s_timer);
+    return ESP_OK;
+}
+
+esp_err_t esp_timer_start_periodic(esp_timer_handle_t timer, uint64_t period_us)
+{
+    (void)timer;
+    (void)period_us;
+    return ESP_OK;
+}
+
+esp_err_t esp_timer_stop(esp_timer_handle_t timer)
+{
+    (void)timer;
+    return ESP_OK;
+}
+
+bool esp_sntp_enabled(void) { return true; }
+
+void esp_sntp_setoperatingmode(int operating_mode) { (void)operating_mode; }
+
+void esp_sntp_setservername(unsigned char idx, const char *server)
+{
+    (void)idx;
+    (void)server;
+}
+
+void esp_sntp_init(void) {}
+
+void vTaskDelay(TickType_t ticks) { (void)ticks; }
+
+void vTaskDelete(void *task) { (void)task; }
+
+BaseType_t xTaskCreate(TaskFunction_t fn, const char *name, uint32_t stack, void *param,
+                       UBaseType_t priority, TaskHandle_t *handle)
+{
+    (void)name;
+    (void)stack;
+    (void)priority;
+    if (handle)
+        *handle = nullptr;
+    std::thread(fn, param).detach();
+    return pdPASS;
+}
+
+uint32_t esp_rom_get_cpu_ticks_per_us(void)
+{
+    return 160;
+}
+
+// ---- Power management / Wi-Fi (PM disabled, as without CONFIG_PM_ENABLE) ----
+
+esp_err_t esp_pm_configure(const void *config)
+{
+    (void)config;
+    return ESP_ERR_NOT_SUPPORTED;
+}
+
+esp_err_t esp_pm_get_configuration(void *config)
+{
+    (void)config;
+    return ESP_ERR_NOT_SUPPORTED;
+}
+
+esp_err_t esp_pm_lock_create(esp_pm_lock_type_t lock_type, int arg, const char *name, esp_pm_lock_handle_t *out_handle)
+{
+    (void)lock_type;
+    (void)arg;
+    (void)name;
+    (void)out_handle;
+    return ESP_ERR_NOT_SUPPORTED;
+}
+
+esp_err_t esp_pm_lock_acquire(esp_pm_lock_handle_t handle)
+{
+    (void)handle;
+    return ESP_ERR_NOT_SUPPORTED;
+}
+
+esp_err_t esp_pm_lock_release(esp_pm_lock_handle_t handle)
+{
+    (void)handle;
+    return ESP_ERR_NOT_SUPPORTED;
+}
+
+esp_err_t esp_pm_lock_delete(esp_pm_lock_handle_t handle)
+{
+    (void)handle;
+    return ESP_ERR_NOT_SUPPORTED;
+}
+
+static wifi_ps_type_t s_wifiPowerSave = WIFI_PS_MIN_MODEM;
+
+esp_err_t esp_wifi_set_ps(wifi_ps_type_t type)
+{
+    s_wifiPowerSave = type;
+    return ESP_OK;
+}
+
+esp_err_t esp_wifi_get_ps(wifi_ps_type_t *type)
+{
+    *type = s_wifiPowerSave;
+    return ESP_OK;
+}
+
+const esp_app_desc_t *esp_app_get_description(void)
+{
+    static const esp_app_desc_t desc = {0xABCD5432, 0, "1.0.0", "esp32_project", {0}};
+    return &desc;
+}
+
+esp_err_t esp_tls_init_global_ca_store(void)
+{
+    return ESP_OK;
+}
+
+esp_err_t esp_tls_set_global_ca_store(const unsigned char *cacert_pem_buf, const unsigned int cacert_pem_bytes)
+{
+    return cacert_pem_buf && cacert_pem_bytes ? ESP_OK : ESP_ERR_INVALID_ARG;
+}
+
+// ---- In-memory flash ----
+
+static const uint32_t kOtaSlotSize = 0x1E0000;
+
+static esp_partition_t s_partitions[2] = {
+    {ESP_PARTITION_TYPE_APP, ESP_PARTITION_SUBTYPE_APP_OTA_0, 0x10000, kOtaSlotSize, "ota_0"},
+    {ESP_PARTITION_TYPE_APP, ESP_PARTITION_SUBTYPE_APP_OTA_1, 0x1F0000, kOtaSlotSize, "ota_1"},
+};
+static std::vector<uint8_t> s_flash[2] = {std::vector<uint8_t>(kOtaSlotSize, 0xFF),
+                                          std::vector<uint8_t>(kOtaSlotSize, 0xFF)};
+static int s_running = 0;
+
+static int slotIndex(const esp_partition_t *partition)
+{
+    return partition == &s_partitions[1] ? 1 : 0;
+}
+
+struct OtaWriteState
+{
+    int slot;
+    size_t offset;
+};
+static std::map<esp_ota_handle_t, OtaWriteState> s_otaWrites;
+static esp_ota_handle_t s_nextOtaHandle = 1;
+
+static const esp_partition_t s_nvsKeysPartition = {ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_DATA_NVS_KEYS,
+                                                   0x3D3000, 0x1000, "nvs_keys"};
+
+const esp_partition_t *esp_partition_find_first(esp_partition_type_t type, esp_partition_subtype_t subtype, const char *label)
+{
+    (void)label;
+    for (const esp_partition_t &partition : s_partitions)
+    {
+        if (partition.type == type && partition.subtype == subtype)
+            return &partition;
+    }
+    return type == ESP_PARTITION_TYPE_DATA && subtype == ESP_PARTITION_SUBTYPE_DATA_NVS_KEYS ? &s_nvsKeysPartition : nullptr;
+}
+
+esp_err_t esp_partition_read(const esp_partition_t *partition, size_t src_offset, void *dst, size_t size)
+{
+    if (!partition || src_offset + size > partition->size)
+        return ESP_ERR_INVALID_SIZE;
+    memcpy(dst, s_flash[slotIndex(partition)].data() + src_offset, size);
+    return ESP_OK;
+}
+
+esp_err_t esp_partition_mmap(const esp_partition_t *partition, size_t offset, size_t size,
+                             esp_partition_mmap_memory_t memory, const void **out_ptr,
+                             esp_partition_mmap_handle_t *out_handle)
+{
+    (void)memory;
+    if (!partition || offset + size > partition->size)
+        return ESP_ERR_INVALID_SIZE;
+    *out_ptr = s_flash[slotIndex(partition)].data() + offset;
+    *out_handle = 0;
+    return ESP_OK;
+}
+
+void esp_partition_munmap(esp_partition_mmap_handle_t handle)
+{
+    (void)handle;
+}
+
+esp_err_t esp_image_get_metadata(const esp_partition_pos_t *part, esp_image_metadata_t *metadata)
+{
+    metadata->image_len = part->size;
+    return ESP_OK;
+}
+
+const esp_partition_t *esp_ota_get_running_partition(void)
+{
+    return &s_partitions[s_running];
+}
+
+const esp_partition_t *esp_ota_get_next_update_partition(const esp_partition_t *start_from)
+{
+    (void)start_from;
+    return &s_partitions[1 - s_running];
+}
+
+esp_err_t esp_ota_begin(const esp_partition_t *partition, size_t image_size, esp_ota_handle_t *out_handle)
+{
+    if (!partition || image_size > partition->size)
+        return ESP_ERR_INVALID_SIZE;
+    int slot = slotIndex(partition);
+    std::fill(s_flash[slot].begin(), s_flash[slot].begin() + image_size, 0xFF);
+    *out_handle = s_nextOtaHandle++;
+    s_otaWrites[*out_handle] = {slot, 0};
+    return ESP_OK;
+}
+
+esp_err_t esp_ota_write(esp_ota_handle_t handle, const void *data, size_t size)
+{
+    auto it = s_otaWrites.find(handle);
+    if (it == s_otaWrites.end())
+        return ESP_ERR_INVALID_ARG;
+    if (it->second.offset + size > kOtaSlotSize)
+        return ESP_ERR_INVALID_SIZE;
+    memcpy(s_flash[it->second.slot].data() + it->second.offset, data, size);
+    it->second.offset += size;
+    return ESP_OK;
+}
+
+esp_err_t esp_ota_end(esp_ota_handle_t handle)
+{
+    return s_otaWrites.erase(handle) ? ESP_OK : ESP_ERR_NOT_FOUND;
+}
+
+esp_err_t esp_ota_abort(esp_ota_handle_t handle)
+{
+    return s_otaWrites.erase(handle) ? ESP_OK : ESP_ERR_NOT_FOUND;
+}
+
+esp_err_t esp_ota_set_boot_partition(const esp_partition_t *partition)
+{
+    (void)partition;
+    return ESP_OK;
+}
+
+// The host always runs a validated image, so the boot health check stays idle
+esp_err_t esp_ota_get_state_partition(const esp_partition_t *partition, esp_ota_img_states_t *ota_state)
+{
+    *ota_state = partition == esp_ota_get_running_partition() ? ESP_OTA_IMG_VALID : ESP_OTA_IMG_UNDEFINED;
+    return ESP_OK;
+}
+
+esp_err_t esp_ota_mark_app_valid_cancel_rollback(void)
+{
+    return ESP_OK;
+}
+
+esp_err_t esp_ota_mark_app_invalid_rollback_and_reboot(void)
+{
+    return ESP_FAIL;
+}
+
+// ---- In-memory NVS ----
+
+static std::map<std::string, std::string> s_nvs;
+static std::map<nvs_handle_t, std::string> s_nvsHandles;
+static nvs_handle_t s_nextNvsHandle = 1;
+
+esp_err_t nvs_flash_init_partition(const char *partition_label)
+{
+    (void)partition_label;
+    return ESP_OK;
+}
+
+esp_err_t nvs_flash_read_security_cfg(const esp_partition_t *partition, nvs_sec_cfg_t *cfg)
+{
+    (void)partition;
+    memset(cfg, 0x5E, sizeof(*cfg));
+    return ESP_OK;
+}
+
+esp_err_t nvs_flash_secure_init_partition(const char *part_name, nvs_sec_cfg_t *cfg)
+{
+    (void)part_name;
+    (void)cfg;
+    return ESP_OK;
+}
+
+esp_err_t nvs_open_from_partition(const char *part_name, const char *name, nvs_open_mode_t open_mode, nvs_handle_t *out_handle)
+{
+    (void)open_mode;
+    *out_handle = s_nextNvsHandle++;
+    s_nvsHandles[*out_handle] = std::string(part_name) + "/" + name + "/";
+    return ESP_OK;
+}
+
+esp_err_t nvs_get_str(nvs_handle_t handle, const char *key, char *out_value, size_t *length)
+{
+    auto it = s_nvs.find(s_nvsHandles[handle] + key);
+    if (it == s_nvs.end())
+        return ESP_ERR_NVS_NOT_FOUND;
+    if (it->second.size() + 1 > *length)
+        return ESP_ERR_INVALID_SIZE;
+    memcpy(out_value, it->second.c_str(), it->second.size() + 1);
+    *length = it->second.size() + 1;
+    return ESP_OK;
+}
+
+esp_err_t nvs_set_str(nvs_handle_t handle, const char *key, const char *value)
+{
+    s_nvs[s_nvsHandles[handle] + key] = value;
+    return ESP_OK;
+}
+
+esp_err_t nvs_get_blob(nvs_handle_t handle, const char *key, void *out_value, size_t *length)
+{
+    auto it = s_nvs.find(s_nvsHandles[handle] + key);
+    if (it == s_nvs.end())
+        return ESP_ERR_NVS_NOT_FOUND;
+    if (!out_value)
+    {
+        *length = it->second.size();
+        return ESP_OK;
+    }
+    if (it->second.size() > *length)
+        return ESP_ERR_INVALID_SIZE;
+    memcpy(out_value, it->second.data(), it->second.size());
+    *length = it->second.size();
+    return ESP_OK;
+}
+
+esp_err_t nvs_set_blob(nvs_handle_t handle, const char *key, const void *value, size_t length)
+{
+    s_nvs[s_nvsHandles[handle] + key].assign(static_cast<const char *>(value), length);
+    return ESP_OK;
+}
+
+esp_err_t nvs_erase_key(nvs_handle_t handle, const char *key)
+{
+    return s_nvs.erase(s_nvsHandles[handle] + key) ? ESP_OK : ESP_ERR_NVS_NOT_FOUND;
+}
+
+esp_err_t nvs_commit(nvs_handle_t handle)
+{
+    return s_nvsHandles.count(handle) ? ESP_OK : ESP_ERR_INVALID_ARG;
+}
+
+void nvs_close(nvs_handle_t handle)
+{
+    s_nvsHandles.erase(handle);
+}
+
+// ---- In-memory HTTP ----
+
+struct host_http_client
+{
+    std::string url;
+    const std::vector<uint8_t> *body;
+    size_t offset;
+    size_t end;
+    std::string range;
+    http_event_handle_cb handler;
+    void *userData;
+    int64_t openedUs;
+    size_t startOffset;
+};
+
+static std::map<std::string, std::vector<uint8_t>> s_httpBodies;
+static int64_t s_linkTtfbUs = 0;
+static int64_t s_linkBytesPerSec = 0;
+
+void host_http_set_link(int64_t ttfbUs, int64_t bytesPerSec)
+{
+    s_linkTtfbUs = ttfbUs;
+    s_linkBytesPerSec = bytesPerSec;
+}
+
+void host_http_serve(const char *url, const uint8_t *body, size_t length)
+{
+    s_httpBodies[url].assign(body, body + length);
+}
+
+esp_http_client_handle_t esp_http_client_init(const esp_http_client_config_t *config)
+{
+    if (!config || !config->url)
+        return nullptr;
+    return new host_http_client{config->url, nullptr, 0, 0, "", config->event_handler, config->user_data, 0, 0};
+}
+
+esp_err_t esp_http_client_set_header(esp_http_client_handle_t client, const char *key, const char *value)
+{
+    if (strcmp(key, "Range") == 0)
+        client->range = value;
+    return ESP_OK;
+}
+
+esp_err_t esp_http_client_open(esp_http_client_handle_t client, int write_len)
+{
+    (void)write_len;
+    auto it = s_httpBodies.find(client->url);
+    if (it == s_httpBodies.end())
+        return ESP_FAIL;
+    client->body = &it->second;
+    client->offset = 0;
+    client->end = it->second.size();
+
+    unsigned long long first = 0, last = 0;
+    int fields = client->range.empty() ? 0 : sscanf(client->range.c_str(), "bytes=%llu-%llu", &first, &last);
+    if (fields >= 1)
+    {
+        client->offset = std::min<size_t>(first, client->end);
+        if (fields == 2)
+            client->end = std::min<size_t>(last + 1, client->end);
+    }
+    client->startOffset = client->offset;
+    if (s_linkTtfbUs > 0)
+        std::this_thread::sleep_for(std::chrono::microseconds(s_linkTtfbUs));
+    client->openedUs = esp_timer_get_time();
+    return ESP_OK;
+}
+
+int64_t esp_http_client_fetch_headers(esp_http_client_handle_t client)
+{
+    if (!client->body)
+        return -1;
+    if (client->handler && !client->range.empty())
+    {
+        char key[] = "Content-Range";
+        char value[64];
+        snprintf(value, sizeof(value), "bytes %zu-%zu/%zu", client->offset, client->end - 1, client->body->size());
+        esp_http_client_event_t evt = {};
+        evt.event_id = HTTP_EVENT_ON_HEADER;
+        evt.client = client;
+        evt.user_data = client->userData;
+        evt.header_key = key;
+        evt.header_value = value;
+        client->handler(&evt);
+    }
+    return static_cast<int64_t>(client->end - client->offset);
+}
+
+int esp_http_client_get_status_code(esp_http_client_handle_t client)
+{
+    if (!client->body)
+        return 404;
+    return client->range.empty() ? 200 : 206;
+}
+
+int esp_http_client_read(esp_http_client_handle_t client, char *buffer, int len)
+{
+    if (!client->body)
+        return -1;
+    size_t n = std::min(static_cast<size_t>(len), client->end - client->offset);
+    memcpy(buffer, client->body->data() + client->offset, n);
+    client->offset += n;
+    if (s_linkBytesPerSec > 0)
+    {
+        // Hold the read until the capped rate would have delivered it
+        int64_t dueUs = client->openedUs + static_cast<int64_t>(client->offset - client->startOffset) * 1000000 / s_linkBytesPerSec;
+        int64_t waitUs = dueUs - esp_timer_get_time();
+        if (waitUs > 0)
+            std::this_thread::sleep_for(std::chrono::microseconds(waitUs));
+    }
+    return static_cast<int>(n);
+}
+
+esp_err_t esp_http_client_close(esp_http_client_handle_t client)
+{
+    client->body = nullptr;
+    return ESP_OK;
+}
+
+esp_err_t esp_http_client_cleanup(esp_http_client_handle_t client)
+{
+    delete client;
+    return ESP_OK;
+}
@@ -0,0 +1,16 @@
+#pragma once
+// Host shim: partition init always succeeds; encrypted partitions are stored in plaintext.
+
+#include "esp_err.h"
+
+esp_err_t nvs_flash_init_partition(const char *partition_label);
+#include "esp_partition.h"
+
+typedef struct
+{
+    uint8_t eky[32];
+    uint8_t tky[32];
+} nvs_sec_cfg_t;
+
+esp_err_t nvs_flash_read_security_cfg(const esp_partition_t *partition, nvs_sec_cfg_t *cfg);
+esp_err_t nvs_flash_secure_init_partition(const char *part_name, nvs_sec_cfg_t *cfg);
@@ -0,0 +1,7 @@
+#pragma once
+// Host shim: values from sdkconfig.esp32dev that the component reads.
+
+#define CONFIG_ESP_DEFAULT_CPU_FREQ_MHZ 160
+// As in a production sdkconfig with flash and NVS encryption, so the encrypted-image benchmarks have a KEK
+// store; sdkconfig.esp32dev leaves both off and the device refuses encrypted commands
+#define CONFIG_NVS_ENCRYPTION 1
@@ -0,0 +1,160 @@
+// Host test for MqttMessageAssembler: feeds update commands the way esp-mqtt
+// delivers them when they exceed the client's 1024-byte receive buffer.
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <ArduinoJson.h>
+#include "Common/MqttMessageAssembler.h"
+
+namespace
+{
+
+int failures = 0;
+
+#define CHECK(cond)                                                   \
+    do                                                                \
+    {                                                                 \
+        if (!(cond))                                                  \
+        {                                                             \
+            fprintf(stderr, "%s:%d: CHECK(%s)\n", __FILE__, __LINE__, #cond); \
+            failures++;                                               \
+        }                                                             \
+    } while (0)
+
+const char *kTopic = "firmware_update/ring/beta";
+constexpr int kBufferSize = 1024;
+
+// Inline signature, mirrors, an encryption block and an activation block: well over 1 KB
+std::string largeCommand()
+{
+    std::string signature(344, 'A');
+    return R"({"version":"2.3.0","firmware_url":"https://example.execute-api.eu-north-1.amazonaws.com/prod/firmware/2.3.0",)"
+           R"("firmware_urls":["https://example.execute-api.eu-north-1.amazonaws.com/prod/firmware/2.3.0",)"
+           R"("https://mirror-1.example.com/firmware/esp32dev/2.3.0/firmware.bin.enc",)"
+           R"("https://mirror-2.example.com/firmware/esp32dev/2.3.0/firmware.bin.enc"],)"
+           R"("signature_url":"https://example-bucket.s3.eu-north-1.amazonaws.com/signatures/2.3.0.sig",)"
+           R"("checksum":"9f86d081884c7d659a2feaa0c55ad015a3bf4f1b2b0b822cd15d6c15b0f00a08",)"
+           R"("signature":")" + signature + R"(",)"
+           R"("encryption":{"alg":"aes-256-ctr","wrapped_key":"q2mYd3Xk7bN0c1pZ8wL4vR6tH5sJ9eF2gA1uC0iO3yT7nM8kB6xQ==",)"
+           R"("iv":"AAECAwQFBgcICQoLDA0ODw=="},)"
+           R"("activation":{"policy":"window","window":"02:00-04:00"}})";
+}
+
+// Splits a message into MQTT_EVENT_DATA events; only the first one carries the topic
+int deliver(MqttMessageAssembler &assembler, const std::string &topic, const std::string &payload, int chunk,
+            int *events = nullptr)
+{
+    int completed = 0;
+    int count = 0;
+    int total = payload.size();
+    int offset = 0;
+    do
+    {
+        int len = std::min(chunk, total - offset);
+        bool first = offset == 0;
+        if (assembler.feed(first ? topic.data() : nullptr, first ? topic.size() : 0, payload.data() + offset, len,
+                           offset, total))
+        {
+            completed++;
+        }
+        offset += len;
+        count++;
+    } while (offset < total);
+    if (events)
+    {
+        *events = count;
+    }
+    return completed;
+}
+
+void testFragmentedCommand()
+{
+    const std::string command = largeCommand();
+    CHECK(command.size() > static_cast<size_t>(kBufferSize));
+
+    // The first fragment on its own is not a command; dispatching it was the old behaviour
+    StaticJsonDocument<2048> doc;
+    CHECK(deserializeJson(doc, command.data(), kBufferSize));
+
+    MqttMessageAssembler assembler(8192);
+    int events = 0;
+    CHECK(deliver(assembler, kTopic, command, kBufferSize, &events) == 1);
+    CHECK(events == 2);
+    CHECK(assembler.topic() == kTopic);
+    CHECK(assembler.payload() == command);
+    CHECK(!deserializeJson(doc, assembler.payload().data(), assembler.payload().size()));
+    CHECK(doc["encryption"]["iv"].as<std::string>() == "AAECAwQFBgcICQoLDA0ODw==");
+    CHECK(doc["activation"]["policy"].as<std::string>() == "window");
+
+    // Small fragments reassemble to the same message
+    CHECK(deliver(assembler, kTopic, command, 100) == 1);
+    CHECK(assembler.payload() == command);
+}
+
+void testSingleEvent()
+{
+    MqttMessageAssembler assembler(8192);
+    const std::string nonce = "abc123";
+    CHECK(deliver(assembler, "device/attest", nonce, kBufferSize) == 1);
+    CHECK(assembler.topic() == "device/attest");
+    CHECK(assembler.payload() == nonce);
+
+    // Empty payloads are still messages
+    CHECK(assembler.feed("device/attest", 13, nullptr, 0, 0, 0));
+    CHECK(assembler.payload().empty());
+}
+
+void testOversizedDropped()
+{
+    MqttMessageAssembler assembler(1500);
+    std::string huge(4000, 'x');
+    CHECK(deliver(assembler, kTopic, huge, kBufferSize) == 0);
+
+    // The next message is unaffected
+    const std::string command = largeCommand();
+    CHECK(deliver(assembler, kTopic, command, kBufferSize) == 1);
+    CHECK(assembler.payload() == command);
+}
+
+void testBrokenStream()
+{
+    MqttMessageAssembler assembler(8192);
+    const std::string command = largeCommand();
+    int total = command.size();
+
+    // A continuation with nothing started before it
+    CHECK(!assembler.feed(nullptr, 0, command.data() + kBufferSize, total - kBufferSize, kBufferSize, total));
+
+    // A gap: the tail arrives at the wrong offset
+    CHECK(!assembler.feed(kTopic, strlen(kTopic), command.data(), 500, 0, total));
+    CHECK(!assembler.feed(nullptr, 0, command.data() + 600, total - 600, 600, total));
+
+    // A new message abandons an unfinished one
+    CHECK(!assembler.feed(kTopic, strlen(kTopic), command.data(), kBufferSize, 0, total));
+    CHECK(deliver(assembler, "firmware_activate", R"({"version":"2.3.0"})", kBufferSize) == 1);
+    CHECK(assembler.topic() == "firmware_activate");
+    CHECK(!assembler.feed(nullptr, 0, command.data() + kBufferSize, total - kBufferSize, kBufferSize, total));
+
+    // Fragments that overrun the total are rejected
+    CHECK(!assembler.feed(kTopic, strlen(kTopic), command.data(), total, 0, total - 1));
+}
+
+} // namespace
+
+int main()
+{
+    testFragmentedCommand();
+    testSingleEvent();
+    testOversizedDropped();
+    testBrokenStream();
+
+    if (failures)
+    {
+        fprintf(stderr, "%d check(s) failed\n", failures);
+        return 1;
+    }
+    printf("mqtt_message_assembler: all checks passed\n");
+    return 0;
+}
@@ -0,0 +1,74 @@
+// Host test for Common/PemDer.h. The decoder runs at compile time, so most checks
+// are static_asserts against a known PEM/DER pair; the rest hands the DER to mbedTLS.
+
+#include <cstdio>
+#include "mbedtls/pk.h"
+#include "Common/PemDer.h"
+
+namespace
+{
+
+// P-256 public key (openssl ec -pubout) and its DER (openssl ec -pubin -outform DER)
+constexpr char kPublicKeyPem[] = R"EOF(
+-----BEGIN PUBLIC KEY-----
+MFkwEwYHKoZIzj0CAQYIKoZIzj0DAQcDQgAE1Vo7yuQV0WfBP4iet2EpJ0cQ7Br1
+4SH5HUZB1N9Imyi9CkHWE+UeNrG8BrSBiigcVerR7Vy+yW2zj+CasD9qXw==
+-----END PUBLIC KEY-----
+)EOF";
+
+constexpr uint8_t kPublicKeyDer[] = {
+    0x30, 0x59, 0x30, 0x13, 0x06, 0x07, 0x2a, 0x86, 0x48, 0xce, 0x3d, 0x02, 0x01, 0x06, 0x08, 0x2a,
+    0x86, 0x48, 0xce, 0x3d, 0x03, 0x01, 0x07, 0x03, 0x42, 0x00, 0x04, 0xd5, 0x5a, 0x3b, 0xca, 0xe4,
+    0x15, 0xd1, 0x67, 0xc1, 0x3f, 0x88, 0x9e, 0xb7, 0x61, 0x29, 0x27, 0x47, 0x10, 0xec, 0x1a, 0xf5,
+    0xe1, 0x21, 0xf9, 0x1d, 0x46, 0x41, 0xd4, 0xdf, 0x48, 0x9b, 0x28, 0xbd, 0x0a, 0x41, 0xd6, 0x13,
+    0xe5, 0x1e, 0x36, 0xb1, 0xbc, 0x06, 0xb4, 0x81, 0x8a, 0x28, 0x1c, 0x55, 0xea, 0xd1, 0xed, 0x5c,
+    0xbe, 0xc9, 0x6d, 0xb3, 0x8f, 0xe0, 0x9a, 0xb0, 0x3f, 0x6a, 0x5f};
+
+template <size_t N, size_t M>
+constexpr bool equals(const PemDer<N> &der, const uint8_t (&expected)[M])
+{
+    if (der.size != M)
+        return false;
+    for (size_t i = 0; i < M; ++i)
+    {
+        if (der.bytes[i] != expected[i])
+            return false;
+    }
+    return true;
+}
+
+constexpr auto kDecoded = pemToDer(kPublicKeyPem);
+static_assert(equals(kDecoded, kPublicKeyDer), "PEM body must decode to the openssl DER");
+
+// CRLF line endings, as a PEM pasted on Windows would have
+constexpr char kCrlfPem[] = "-----BEGIN TEST-----\r\nAAEC\r\nAwQ=\r\n-----END TEST-----\r\n";
+constexpr uint8_t kCrlfDer[] = {0x00, 0x01, 0x02, 0x03, 0x04};
+static_assert(equals(pemToDer(kCrlfPem), kCrlfDer), "CR/LF between lines is ignored");
+
+// Malformed input decodes to size 0, which CredentialStore::begin() rejects
+constexpr char kPlaceholderPem[] = "-----BEGIN CERTIFICATE-----\n.........\n-----END CERTIFICATE-----\n";
+static_assert(pemToDer(kPlaceholderPem).size == 0, "placeholder PEM is malformed");
+constexpr char kNoEndPem[] = "-----BEGIN TEST-----\nAAECAwQ=\n";
+static_assert(pemToDer(kNoEndPem).size == 0, "PEM without an END line is malformed");
+constexpr char kNoBeginPem[] = "AAECAwQ=\n-----END TEST-----\n";
+static_assert(pemToDer(kNoBeginPem).size == 0, "PEM without a BEGIN line is malformed");
+constexpr char kDataAfterPadPem[] = "-----BEGIN TEST-----\nAAE=Cg==\n-----END TEST-----\n";
+static_assert(pemToDer(kDataAfterPadPem).size == 0, "data after padding is malformed");
+
+} // namespace
+
+int main()
+{
+    // The DER must be something mbedTLS accepts, not just the right bytes
+    mbedtls_pk_context pk;
+    mbedtls_pk_init(&pk);
+    int ret = mbedtls_pk_parse_public_key(&pk, kDecoded.bytes, kDecoded.size);
+    mbedtls_pk_free(&pk);
+    if (ret != 0)
+    {
+        fprintf(stderr, "mbedtls_pk_parse_public_key returned %d\n", ret);
+        return 1;
+    }
+    printf("pem_der: all checks passed\n");
+    return 0;
+}
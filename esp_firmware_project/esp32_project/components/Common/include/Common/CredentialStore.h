@@ -0,0 +1,47 @@
+#pragma once
+
+#include <memory>
+#include <mutex>
+#include <string>
+#include "mbedtls/pk.h"
+#include "esp_log.h"
+#include "Common/certificates.h"
+
+inline const char *TAG_CREDENTIAL_STORE = "[Common:CredentialStore]";
+
+// Process-wide owner of the device's TLS and signing credentials.
+//
+// The device certificate and key are handed out as the DER that certificates.cpp
+// decodes at build time, so they take no heap. The CA goes into the esp-tls
+// global CA store, which every esp_mqtt_client / esp_http_client connection with
+// use_global_ca_store shares, and the firmware signing key is parsed once into a
+// shared mbedtls_pk_context.
+class CredentialStore
+{
+public:
+    static CredentialStore &instance();
+
+    // Checks the credentials and installs the global CA store. Safe to call more than once.
+    // Aborts if a credential in certificates.cpp decoded to an empty DER blob; returns
+    // false if only the CA store could not be installed.
+    bool begin();
+
+    bool hasGlobalCaStore() const;
+
+    // In flash; valid for the life of the process
+    const DerBlob &clientCertDer() const;
+    const DerBlob &clientKeyDer() const;
+
+    // Parsed firmware signing public key, or nullptr if it failed to parse.
+    std::shared_ptr<mbedtls_pk_context> firmwareSignKey();
+
+private:
+    CredentialStore() = default;
+    CredentialStore(const CredentialStore &) = delete;
+    CredentialStore &operator=(const CredentialStore &) = delete;
+
+    std::mutex mutex;
+    bool initialized = false;
+    bool globalCaStore = false;
+    std::shared_ptr<mbedtls_pk_context> signKey;
+};
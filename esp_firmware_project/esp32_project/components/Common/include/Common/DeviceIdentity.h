@@ -0,0 +1,30 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include "esp_log.h"
+
+inline const char *TAG_DEVICE_IDENTITY = "[Common:DeviceIdentity]";
+
+// Fleet identity provisioned into NVS namespace "identity" (keys hw_rev, site, ring).
+//
+// Every field that is set becomes a cohort topic, firmware_update/<key>/<value>,
+// which the device subscribes to next to its per-MAC topic so a rollout can be
+// published once per cohort instead of once per device. firmware_activate/<key>/<value>
+// does the same for activating staged firmware.
+class DeviceIdentity
+{
+public:
+    // Reads the identity from NVS. Missing or invalid fields are skipped.
+    bool load();
+
+    const std::vector<std::string> &cohortTopics() const;
+    bool isCohortTopic(const char *topic, int topicLen) const;
+
+    const std::vector<std::string> &activationTopics() const;
+    bool isActivationTopic(const char *topic, int topicLen) const;
+
+private:
+    std::vector<std::string> topics;
+    std::vector<std::string> activateTopics;
+};
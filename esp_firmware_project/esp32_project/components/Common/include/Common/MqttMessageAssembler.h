@@ -0,0 +1,33 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include "esp_log.h"
+
+inline const char *TAG_MQTT_ASSEMBLER = "[Common:MqttMessageAssembler]";
+
+// Rebuilds MQTT messages that esp-mqtt delivers as several MQTT_EVENT_DATA events.
+//
+// A message larger than the client's receive buffer (1024 bytes by default) arrives
+// as a first event carrying the topic and current_data_offset 0, followed by events
+// with no topic and increasing offsets, each reporting the same total_data_len. Only
+// a complete message is handed on; one larger than maxSize is dropped.
+class MqttMessageAssembler
+{
+public:
+    explicit MqttMessageAssembler(size_t maxSize);
+
+    // Feeds one MQTT_EVENT_DATA event. Returns true once topic() and payload() hold a
+    // complete message; they stay valid until the next call.
+    bool feed(const char *topic, int topicLen, const char *data, int dataLen, int offset, int totalLen);
+
+    const std::string &topic() const;
+    const std::string &payload() const;
+
+private:
+    size_t maxSize;
+    std::string currentTopic;
+    std::string buffer;
+    size_t expectedLen;
+    bool assembling;
+};
@@ -0,0 +1,90 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// DER bytes of a PEM block, decoded at compile time so they live in flash
+template <size_t N>
+struct PemDer
+{
+    uint8_t bytes[N * 3 / 4 + 1];
+    size_t size; // 0 if the PEM is malformed
+};
+
+namespace pem_detail
+{
+
+constexpr int base64Value(char c)
+{
+    return c >= 'A' && c <= 'Z'   ? c - 'A'
+           : c >= 'a' && c <= 'z' ? c - 'a' + 26
+           : c >= '0' && c <= '9' ? c - '0' + 52
+           : c == '+'             ? 62
+           : c == '/'             ? 63
+                                  : -1;
+}
+
+template <size_t N>
+constexpr size_t find(const char (&s)[N], size_t from, const char *needle)
+{
+    for (size_t i = from; i < N; ++i)
+    {
+        size_t j = 0;
+        while (needle[j] != '\0' && i + j < N && s[i + j] == needle[j])
+        {
+            ++j;
+        }
+        if (needle[j] == '\0')
+        {
+            return i;
+        }
+    }
+    return N;
+}
+
+} // namespace pem_detail
+
+// Decodes the base64 body of the first PEM block in `pem`
+template <size_t N>
+constexpr PemDer<N> pemToDer(const char (&pem)[N])
+{
+    PemDer<N> out{};
+    size_t begin = pem_detail::find(pem, 0, "-----BEGIN ");
+    begin = begin < N ? pem_detail::find(pem, begin, "\n") : N;
+    const size_t end = begin < N ? pem_detail::find(pem, begin, "-----END ") : N;
+    if (end >= N)
+    {
+        return out;
+    }
+
+    uint32_t bits = 0;
+    int bitCount = 0;
+    bool padded = false;
+    for (size_t i = begin + 1; i < end; ++i)
+    {
+        const char c = pem[i];
+        if (c == '\r' || c == '\n')
+        {
+            continue;
+        }
+        if (c == '=')
+        {
+            padded = true;
+            continue;
+        }
+        const int value = pem_detail::base64Value(c);
+        if (value < 0 || padded)
+        {
+            out.size = 0;
+            return out;
+        }
+        bits = (bits << 6) | static_cast<uint32_t>(value);
+        bitCount += 6;
+        if (bitCount >= 8)
+        {
+            bitCount -= 8;
+            out.bytes[out.size++] = static_cast<uint8_t>(bits >> bitCount);
+        }
+    }
+    return out;
+}
@@ -1,7 +1,20 @@
 #pragma once
 
+#include <cstddef>
+#include <cstdint>
+
 extern const char* AWS_CA_CERT;
 extern const char* IoT_CLIENT_CERT;
 extern const char* IoT_PRIVATE_KEY;
 extern const char* FIRMWARE_SIGN_KEY;
 
+// DER of the PEM credentials above, decoded at build time into flash (size 0 if malformed)
+struct DerBlob
+{
+    const uint8_t *data;
+    size_t size;
+};
+
+extern const DerBlob AWS_CA_CERT_DER;
+extern const DerBlob IoT_CLIENT_CERT_DER;
+extern const DerBlob IoT_PRIVATE_KEY_DER;
@@ -0,0 +1,89 @@
+#include "Common/CredentialStore.h"
+#include "Common/certificates.h"
+#include "esp_tls.h"
+#include <cstdlib>
+#include <cstring>
+
+CredentialStore &CredentialStore::instance()
+{
+    static CredentialStore store;
+    return store;
+}
+
+bool CredentialStore::begin()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    if (initialized)
+        return true;
+
+    // An empty blob is a broken build, not a runtime condition: without credentials the
+    // device can never reach the broker, so stop here. A trial image rolls back on the reset.
+    if (IoT_CLIENT_CERT_DER.size == 0 || IoT_PRIVATE_KEY_DER.size == 0)
+    {
+        ESP_LOGE(TAG_CREDENTIAL_STORE, "Device certificate/key PEM in certificates.cpp is malformed");
+        abort();
+    }
+    if (AWS_CA_CERT_DER.size == 0)
+    {
+        ESP_LOGE(TAG_CREDENTIAL_STORE, "CA certificate PEM in certificates.cpp is malformed");
+        abort();
+    }
+
+    esp_err_t err = esp_tls_init_global_ca_store();
+    if (err == ESP_OK)
+    {
+        err = esp_tls_set_global_ca_store(AWS_CA_CERT_DER.data, AWS_CA_CERT_DER.size);
+    }
+    if (err != ESP_OK)
+    {
+        ESP_LOGE(TAG_CREDENTIAL_STORE, "Failed to set global CA store: %s", esp_err_to_name(err));
+        return false;
+    }
+    globalCaStore = true;
+    initialized = true;
+
+    ESP_LOGI(TAG_CREDENTIAL_STORE, "Credentials loaded (cert %u B, key %u B, CA %u B DER)",
+             (unsigned)IoT_CLIENT_CERT_DER.size, (unsigned)IoT_PRIVATE_KEY_DER.size, (unsigned)AWS_CA_CERT_DER.size);
+    return true;
+}
+
+bool CredentialStore::hasGlobalCaStore() const
+{
+    return globalCaStore;
+}
+
+const DerBlob &CredentialStore::clientCertDer() const
+{
+    return IoT_CLIENT_CERT_DER;
+}
+
+const DerBlob &CredentialStore::clientKeyDer() const
+{
+    return IoT_PRIVATE_KEY_DER;
+}
+
+std::shared_ptr<mbedtls_pk_context> CredentialStore::firmwareSignKey()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    if (signKey)
+        return signKey;
+
+    std::shared_ptr<mbedtls_pk_context> key(new mbedtls_pk_context, [](mbedtls_pk_context *pk)
+                                            {
+                                                mbedtls_pk_free(pk);
+                                                delete pk;
+                                            });
+    mbedtls_pk_init(key.get());
+
+    int ret = mbedtls_pk_parse_public_key(key.get(),
+                                          reinterpret_cast<const uint8_t *>(FIRMWARE_SIGN_KEY),
+                                          strlen(FIRMWARE_SIGN_KEY) + 1);
+    if (ret != 0)
+    {
+        ESP_LOGE(TAG_CREDENTIAL_STORE, "Failed to parse firmware signing key. mbedtls_pk_parse_public_key returned %d", ret);
+        return nullptr;
+    }
+
+    signKey = key;
+    return signKey;
+}
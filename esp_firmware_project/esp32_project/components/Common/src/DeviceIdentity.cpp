@@ -0,0 +1,83 @@
+#include "Common/DeviceIdentity.h"
+#include "nvs.h"
+#include <cstring>
+
+#define NVS_NAMESPACE_IDENTITY "identity"
+
+static const char *const kCohortKeys[] = {"hw_rev", "site", "ring"};
+
+// Values end up as a topic level, so MQTT separators and wildcards are rejected
+static bool isValidTopicLevel(const char *value)
+{
+    size_t len = strlen(value);
+    return len > 0 && strpbrk(value, "/+#") == nullptr;
+}
+
+bool DeviceIdentity::load()
+{
+    topics.clear();
+    activateTopics.clear();
+
+    nvs_handle_t handle;
+    esp_err_t err = nvs_open(NVS_NAMESPACE_IDENTITY, NVS_READONLY, &handle);
+    if (err != ESP_OK)
+    {
+        ESP_LOGW(TAG_DEVICE_IDENTITY, "No provisioned identity (%s), cohort topics disabled", esp_err_to_name(err));
+        return false;
+    }
+
+    for (const char *key : kCohortKeys)
+    {
+        char value[33] = {0};
+        size_t len = sizeof(value);
+        err = nvs_get_str(handle, key, value, &len);
+        if (err == ESP_ERR_NVS_NOT_FOUND)
+        {
+            continue;
+        }
+        if (err != ESP_OK || !isValidTopicLevel(value))
+        {
+            ESP_LOGW(TAG_DEVICE_IDENTITY, "Ignoring invalid identity field '%s'", key);
+            continue;
+        }
+
+        topics.push_back(std::string("firmware_update/") + key + "/" + value);
+        activateTopics.push_back(std::string("firmware_activate/") + key + "/" + value);
+        ESP_LOGI(TAG_DEVICE_IDENTITY, "Cohort topic: %s", topics.back().c_str());
+    }
+    nvs_close(handle);
+
+    return !topics.empty();
+}
+
+const std::vector<std::string> &DeviceIdentity::cohortTopics() const
+{
+    return topics;
+}
+
+static bool containsTopic(const std::vector<std::string> &topics, const char *topic, int topicLen)
+{
+    for (const std::string &t : topics)
+    {
+        if (t.size() == static_cast<size_t>(topicLen) && strncmp(topic, t.c_str(), topicLen) == 0)
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool DeviceIdentity::isCohortTopic(const char *topic, int topicLen) const
+{
+    return containsTopic(topics, topic, topicLen);
+}
+
+const std::vector<std::string> &DeviceIdentity::activationTopics() const
+{
+    return activateTopics;
+}
+
+bool DeviceIdentity::isActivationTopic(const char *topic, int topicLen) const
+{
+    return containsTopic(activateTopics, topic, topicLen);
+}
@@ -0,0 +1,68 @@
+#include "Common/MqttMessageAssembler.h"
+
+MqttMessageAssembler::MqttMessageAssembler(size_t maxSize)
+    : maxSize(maxSize), expectedLen(0), assembling(false) {}
+
+bool MqttMessageAssembler::feed(const char *topic, int topicLen, const char *data, int dataLen, int offset,
+                                int totalLen)
+{
+    if (dataLen < 0 || offset < 0 || totalLen < 0 || static_cast<size_t>(offset) + dataLen > static_cast<size_t>(totalLen))
+    {
+        ESP_LOGW(TAG_MQTT_ASSEMBLER, "Ignoring malformed fragment (offset %d, len %d, total %d)", offset, dataLen,
+                 totalLen);
+        assembling = false;
+        return false;
+    }
+
+    if (offset == 0)
+    {
+        // A new message; any unfinished one before it is lost
+        if (assembling)
+        {
+            ESP_LOGW(TAG_MQTT_ASSEMBLER, "Dropping incomplete message on %s (%u of %u bytes)", currentTopic.c_str(),
+                     (unsigned)buffer.size(), (unsigned)expectedLen);
+        }
+        currentTopic.assign(topic ? topic : "", topic ? topicLen : 0);
+        buffer.clear();
+        assembling = false;
+
+        if (static_cast<size_t>(totalLen) > maxSize)
+        {
+            ESP_LOGE(TAG_MQTT_ASSEMBLER, "Message on %s is %d bytes, limit is %u", currentTopic.c_str(), totalLen,
+                     (unsigned)maxSize);
+            return false;
+        }
+        buffer.reserve(totalLen);
+        expectedLen = totalLen;
+        assembling = true;
+    }
+    else if (!assembling || static_cast<size_t>(offset) != buffer.size() || static_cast<size_t>(totalLen) != expectedLen)
+    {
+        // Continuation of a dropped message, or a gap in the stream
+        if (assembling)
+        {
+            ESP_LOGW(TAG_MQTT_ASSEMBLER, "Fragment at offset %d does not follow %u bytes, dropping message", offset,
+                     (unsigned)buffer.size());
+        }
+        assembling = false;
+        return false;
+    }
+
+    buffer.append(data, dataLen);
+    if (buffer.size() < expectedLen)
+    {
+        return false;
+    }
+    assembling = false;
+    return true;
+}
+
+const std::string &MqttMessageAssembler::topic() const
+{
+    return currentTopic;
+}
+
+const std::string &MqttMessageAssembler::payload() const
+{
+    return buffer;
+}
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <cstdint>
+#include "freertos/FreeRTOS.h"
+#include "freertos/event_groups.h"
+#include "esp_event.h"
+#include "esp_timer.h"
+#include "esp_log.h"
+
+inline const char *TAG_CONNECTIVITY = "[Connectivity]";
+
+class ConnectivityManager
+{
+public:
+    ConnectivityManager();
+
+    // Starts Wi-Fi in station mode. Uses the channel/BSSID cached in NVS from
+    // the last successful connection to skip the full scan when possible.
+    bool begin(const char *ssid, const char *password);
+
+    // Blocks until the station has an IP (IP_EVENT_STA_GOT_IP) or the timeout expires.
+    bool waitForIp(TickType_t timeout = portMAX_DELAY);
+
+    bool isConnected() const;
+
+    // Called from the event loop task on every IP_EVENT_STA_GOT_IP; keep it short.
+    void setIpCallback(void (*callback)());
+
+    // Logs boot-to-first-publish time; only the first call reports.
+    void markFirstPublish();
+
+private:
+    static constexpr uint32_t kBackoffBaseMs = 500;
+    static constexpr uint32_t kBackoffMaxMs = 60000;
+
+    EventGroupHandle_t eventGroup;
+    esp_timer_handle_t reconnectTimer;
+    uint32_t retryCount;
+    bool usingCachedAp;
+    bool firstPublishReported;
+    void (*ipCallback)();
+
+    static void eventHandler(void *arg, esp_event_base_t eventBase, int32_t eventId, void *eventData);
+    static void reconnectTimerCallback(void *arg);
+
+    void onDisconnected();
+    void onGotIp();
+    void scheduleReconnect();
+
+    bool loadCachedAp(uint8_t *channel, uint8_t bssid[6]);
+    void storeCachedAp(uint8_t channel, const uint8_t bssid[6]);
+};
@@ -0,0 +1,233 @@
+#include "ConnectivityManager/ConnectivityManager.h"
+#include "esp_wifi.h"
+#include "esp_netif.h"
+#include "nvs.h"
+#include <cstring>
+#include <algorithm>
+#include <inttypes.h>
+
+#define CONNECTED_BIT BIT0
+
+#define NVS_NAMESPACE_WIFI "wifi"
+#define NVS_KEY_CHANNEL "channel"
+#define NVS_KEY_BSSID "bssid"
+
+ConnectivityManager::ConnectivityManager()
+    : eventGroup(xEventGroupCreate()), reconnectTimer(nullptr), retryCount(0),
+      usingCachedAp(false), firstPublishReported(false), ipCallback(nullptr) {}
+
+bool ConnectivityManager::begin(const char *ssid, const char *password)
+{
+    esp_netif_init();
+    esp_event_loop_create_default();
+    esp_netif_create_default_wifi_sta();
+
+    wifi_init_config_t wifi_init_cfg = WIFI_INIT_CONFIG_DEFAULT();
+    esp_err_t err = esp_wifi_init(&wifi_init_cfg);
+    if (err != ESP_OK)
+    {
+        ESP_LOGE(TAG_CONNECTIVITY, "esp_wifi_init failed: %s", esp_err_to_name(err));
+        return false;
+    }
+
+    esp_timer_create_args_t timer_args = {};
+    timer_args.callback = &ConnectivityManager::reconnectTimerCallback;
+    timer_args.arg = this;
+    timer_args.name = "wifi_reconnect";
+    esp_timer_create(&timer_args, &reconnectTimer);
+
+    esp_event_handler_register(WIFI_EVENT, ESP_EVENT_ANY_ID, &ConnectivityManager::eventHandler, this);
+    esp_event_handler_register(IP_EVENT, IP_EVENT_STA_GOT_IP, &ConnectivityManager::eventHandler, this);
+
+    wifi_config_t wifi_config = {};
+    strncpy((char *)wifi_config.sta.ssid, ssid, sizeof(wifi_config.sta.ssid) - 1);
+    strncpy((char *)wifi_config.sta.password, password, sizeof(wifi_config.sta.password) - 1);
+
+    uint8_t channel = 0;
+    uint8_t bssid[6] = {0};
+    if (loadCachedAp(&channel, bssid))
+    {
+        wifi_config.sta.channel = channel;
+        wifi_config.sta.bssid_set = true;
+        memcpy(wifi_config.sta.bssid, bssid, sizeof(bssid));
+        usingCachedAp = true;
+        ESP_LOGI(TAG_CONNECTIVITY, "Fast connect using cached AP %02X:%02X:%02X:%02X:%02X:%02X on channel %u",
+                 bssid[0], bssid[1], bssid[2], bssid[3], bssid[4], bssid[5], channel);
+    }
+
+    esp_wifi_set_mode(WIFI_MODE_STA);
+    esp_wifi_set_config(WIFI_IF_STA, &wifi_config);
+
+    err = esp_wifi_start();
+    if (err != ESP_OK)
+    {
+        ESP_LOGE(TAG_CONNECTIVITY, "esp_wifi_start failed: %s", esp_err_to_name(err));
+        return false;
+    }
+
+    ESP_LOGI(TAG_CONNECTIVITY, "Wi-Fi started. SSID: %s", ssid);
+    return true;
+}
+
+bool ConnectivityManager::waitForIp(TickType_t timeout)
+{
+    EventBits_t bits = xEventGroupWaitBits(eventGroup, CONNECTED_BIT, pdFALSE, pdTRUE, timeout);
+    return (bits & CONNECTED_BIT) != 0;
+}
+
+bool ConnectivityManager::isConnected() const
+{
+    return (xEventGroupGetBits(eventGroup) & CONNECTED_BIT) != 0;
+}
+
+void ConnectivityManager::setIpCallback(void (*callback)())
+{
+    ipCallback = callback;
+}
+
+void ConnectivityManager::markFirstPublish()
+{
+    if (firstPublishReported)
+    {
+        return;
+    }
+    firstPublishReported = true;
+    ESP_LOGI(TAG_CONNECTIVITY, "Boot to first publish: %" PRId64 " ms", esp_timer_get_time() / 1000);
+}
+
+void ConnectivityManager::eventHandler(void *arg, esp_event_base_t eventBase, int32_t eventId, void *eventData)
+{
+    ConnectivityManager *self = static_cast<ConnectivityManager *>(arg);
+
+    if (eventBase == WIFI_EVENT && eventId == WIFI_EVENT_STA_START)
+    {
+        ESP_LOGI(TAG_CONNECTIVITY, "Wi-Fi connecting...");
+        esp_wifi_connect();
+    }
+    else if (eventBase == WIFI_EVENT && eventId == WIFI_EVENT_STA_CONNECTED)
+    {
+        ESP_LOGI(TAG_CONNECTIVITY, "Wi-Fi connected");
+    }
+    else if (eventBase == WIFI_EVENT && eventId == WIFI_EVENT_STA_DISCONNECTED)
+    {
+        self->onDisconnected();
+    }
+    else if (eventBase == IP_EVENT && eventId == IP_EVENT_STA_GOT_IP)
+    {
+        self->onGotIp();
+    }
+}
+
+void ConnectivityManager::reconnectTimerCallback(void *arg)
+{
+    ESP_LOGI(TAG_CONNECTIVITY, "Retrying to connect...");
+    esp_wifi_connect();
+}
+
+void ConnectivityManager::onDisconnected()
+{
+    xEventGroupClearBits(eventGroup, CONNECTED_BIT);
+
+    if (usingCachedAp)
+    {
+        // The cached AP may have moved or gone; fall back to a full scan right away
+        ESP_LOGW(TAG_CONNECTIVITY, "Cached AP unavailable, falling back to full scan");
+        usingCachedAp = false;
+
+        wifi_config_t wifi_config = {};
+        esp_wifi_get_config(WIFI_IF_STA, &wifi_config);
+        wifi_config.sta.bssid_set = false;
+        wifi_config.sta.channel = 0;
+        esp_wifi_set_config(WIFI_IF_STA, &wifi_config);
+        esp_wifi_connect();
+        return;
+    }
+
+    ESP_LOGW(TAG_CONNECTIVITY, "Wi-Fi lost connection");
+    scheduleReconnect();
+}
+
+void ConnectivityManager::scheduleReconnect()
+{
+    uint32_t shift = std::min<uint32_t>(retryCount, 7);
+    uint32_t delayMs = std::min<uint32_t>(kBackoffBaseMs << shift, kBackoffMaxMs);
+    retryCount++;
+
+    ESP_LOGI(TAG_CONNECTIVITY, "Reconnect attempt %" PRIu32 " in %" PRIu32 " ms", retryCount, delayMs);
+    esp_timer_stop(reconnectTimer);
+    esp_timer_start_once(reconnectTimer, static_cast<uint64_t>(delayMs) * 1000);
+}
+
+void ConnectivityManager::onGotIp()
+{
+    retryCount = 0;
+    // Connected: a later disconnect is a lost link, not a stale cached AP
+    usingCachedAp = false;
+    xEventGroupSetBits(eventGroup, CONNECTED_BIT);
+    ESP_LOGI(TAG_CONNECTIVITY, "Got IP %" PRId64 " ms after boot", esp_timer_get_time() / 1000);
+
+    wifi_ap_record_t ap_info;
+    if (esp_wifi_sta_get_ap_info(&ap_info) == ESP_OK)
+    {
+        storeCachedAp(ap_info.primary, ap_info.bssid);
+    }
+
+    if (ipCallback)
+    {
+        ipCallback();
+    }
+}
+
+bool ConnectivityManager::loadCachedAp(uint8_t *channel, uint8_t bssid[6])
+{
+    nvs_handle_t handle;
+    if (nvs_open(NVS_NAMESPACE_WIFI, NVS_READONLY, &handle) != ESP_OK)
+    {
+        return false;
+    }
+
+    size_t bssid_len = 6;
+    esp_err_t err = nvs_get_u8(handle, NVS_KEY_CHANNEL, channel);
+    if (err == ESP_OK)
+    {
+        err = nvs_get_blob(handle, NVS_KEY_BSSID, bssid, &bssid_len);
+    }
+    nvs_close(handle);
+
+    return err == ESP_OK && bssid_len == 6 && *channel != 0;
+}
+
+void ConnectivityManager::storeCachedAp(uint8_t channel, const uint8_t bssid[6])
+{
+    uint8_t cached_channel = 0;
+    uint8_t cached_bssid[6] = {0};
+    if (loadCachedAp(&cached_channel, cached_bssid) &&
+        cached_channel == channel && memcmp(cached_bssid, bssid, 6) == 0)
+    {
+        return; // Unchanged, avoid a flash write on every connect
+    }
+
+    nvs_handle_t handle;
+    esp_err_t err = nvs_open(NVS_NAMESPACE_WIFI, NVS_READWRITE, &handle);
+    if (err != ESP_OK)
+    {
+        ESP_LOGW(TAG_CONNECTIVITY, "Failed to open NVS for AP cache: %s", esp_err_to_name(err));
+        return;
+    }
+
+    err = nvs_set_u8(handle, NVS_KEY_CHANNEL, channel);
+    if (err == ESP_OK)
+    {
+        err = nvs_set_blob(handle, NVS_KEY_BSSID, bssid, 6);
+    }
+    if (err == ESP_OK)
+    {
+        err = nvs_commit(handle);
+    }
+    nvs_close(handle);
+
+    if (err != ESP_OK)
+    {
+        ESP_LOGW(TAG_CONNECTIVITY, "Failed to cache AP: %s", esp_err_to_name(err));
+    }
+}
@@ -0,0 +1,97 @@
+#pragma once
+
+#include <string>
+#include <mutex>
+#include <atomic>
+#include <cstdint>
+#include "esp_partition.h"
+#include "esp_timer.h"
+#include "esp_log.h"
+#include "NVSStorageHandler.h"
+
+inline const char *TAG_OTA_ACTIVATION = "[OTAUpdate:ActivationManager]";
+
+// When a staged image becomes the running one
+struct ActivationPolicy
+{
+    enum class Type : uint8_t
+    {
+        Immediate, // Switch and restart as soon as the image is verified
+        Window,    // Switch and restart inside a daily UTC window
+        Command,   // Switch and restart on an MQTT activate command
+        NextBoot,  // Switch now, run it whenever the device next reboots
+    };
+
+    Type type = Type::Immediate;
+    uint16_t windowStartMin = 0; // Minutes after UTC midnight; the window may wrap past midnight
+    uint16_t windowEndMin = 0;
+};
+
+// Decouples activation from download: a verified image stays staged in the inactive
+// slot and is recorded as pending in NVS until its policy activates it.
+//
+// The new version is committed to NVS by finalizePendingActivation() on the first
+// boot that actually runs the staged partition. When that boot is on trial (the
+// bootloader's rollback is pending verification), the record is kept until
+// commitTrial(); if the bootloader rolls back instead, the previous version is
+// restored on the next boot.
+class ActivationManager
+{
+public:
+    static ActivationManager &instance();
+
+    // Commits the pending version once its partition runs. Call at boot before the version is read.
+    void finalizePendingActivation();
+
+    // Drops the trial record once BootHealthCheck has marked the running image valid
+    void commitTrial();
+    std::string trialVersion();
+
+    // Re-arms a window staged before the last reboot. Call once the network is up.
+    void start();
+
+    // Records the verified `partition` as pending and applies `policy`
+    bool stage(const esp_partition_t *partition, const std::string &version, const ActivationPolicy &policy);
+
+    // Forgets the staged image if it lives in `partition`, which is about to be overwritten
+    void discard(const esp_partition_t *partition);
+
+    // Switches to the staged image and restarts from a background task, if it is `version`
+    bool activate(const std::string &version);
+
+    std::string pendingVersion();
+    bool restartScheduled() const;
+
+private:
+    static constexpr uint64_t kWindowPollUs = 60ULL * 1000 * 1000;
+
+    // Persisted as one NVS blob; append fields only
+    struct PendingRecord
+    {
+        uint32_t partitionAddress;
+        uint8_t policy;
+        uint8_t flags;
+        uint16_t windowStartMin;
+        uint16_t windowEndMin;
+        char version[32];
+        char previousVersion[32]; // Restored if the trial boot is rolled back
+    };
+
+    static constexpr uint8_t kFlagTrial = 0x01; // The staged partition has booted, pending its health check
+
+    ActivationManager();
+
+    std::mutex mutex;
+    NVSStorageHandler nvs;
+    esp_timer_handle_t windowTimer = nullptr;
+    std::atomic<bool> restarting{false};
+
+    bool loadRecord(PendingRecord &record);
+    bool storeRecord(const PendingRecord &record);
+    void clearRecord();
+    bool startActivation(const PendingRecord &record);
+    void armWindow(const PendingRecord &record);
+
+    static void onWindowTick(void *arg);
+    static void activateTask(void *arg);
+};
@@ -0,0 +1,87 @@
+#pragma once
+
+#include <string>
+#include <mutex>
+#include <condition_variable>
+#include <cstdint>
+#include "esp_log.h"
+#include "NVSStorageHandler.h"
+
+inline const char *TAG_OTA_HEALTH = "[OTAUpdate:BootHealthCheck]";
+
+// Validates the first boot of a new image. While the bootloader has the running
+// image pending verification, it must get an IP, connect MQTT and have its
+// firmware topic subscription acknowledged within the deadline. On success the
+// image is marked valid; otherwise it is marked invalid and the device reboots
+// into the previous image.
+//
+// The outcome and boot-to-healthy time are kept in NVS and included in the status
+// report, so a rolled-back device reports why on its next connect.
+class BootHealthCheck
+{
+public:
+    static BootHealthCheck &instance();
+
+    // Starts the deadline if the running image is pending verification. Call once at boot.
+    void begin(uint32_t deadlineMs);
+
+    void onGotIp();
+    // `firmwareTopicMsgId` is esp_mqtt_client_subscribe()'s id for device_firmware_topic
+    void onMqttConnected(int firmwareTopicMsgId);
+    // Returns true if this acknowledgement completed the check
+    bool onSubscribed(int msgId, bool granted);
+
+    // True until the running image has been marked valid
+    bool pending();
+
+    // {"version", "result": "passed"|"rolled_back", "stage", "ms"} of the last checked boot, or ""
+    std::string lastOutcomeJson();
+
+    // Records `version` as rolled back, for a rollback the deadline did not cause
+    // (a reset during the trial boot, or the bootloader refusing the image)
+    void recordRollback(const std::string &version);
+    // True if the last checked boot was `version` and it was rolled back
+    bool rolledBack(const std::string &version);
+
+private:
+    enum class Stage : uint8_t
+    {
+        Boot,
+        Ip,
+        Mqtt,
+        Subscribed,
+    };
+
+    // Persisted as one NVS blob; append fields only
+    struct OutcomeRecord
+    {
+        uint8_t passed;
+        uint8_t stage;
+        uint16_t reserved;
+        uint32_t elapsedMs; // Boot to healthy, or boot to the deadline
+        char version[32];
+    };
+
+    BootHealthCheck();
+
+    std::mutex mutex;
+    std::condition_variable cv;
+    NVSStorageHandler nvs;
+    bool armed = false;
+    bool healthy = false;
+    bool expired = false;
+    Stage stage = Stage::Boot;
+    int expectedMsgId = -1;
+    uint32_t deadlineMs = 0;
+    std::string version;
+
+    static constexpr uint8_t kStageUnknown = 0xFF;
+
+    void advance(Stage reached);
+    void storeOutcome(bool passed, uint32_t elapsedMs);
+    bool loadOutcome(OutcomeRecord &record);
+    void writeOutcome(const OutcomeRecord &record);
+
+    static const char *stageName(uint8_t stage);
+    static void deadlineTask(void *arg);
+};
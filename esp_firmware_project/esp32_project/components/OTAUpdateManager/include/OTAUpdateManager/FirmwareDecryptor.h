@@ -0,0 +1,47 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <vector>
+#include "esp_log.h"
+#include "mbedtls/aes.h"
+
+inline const char *TAG_OTA_DECRYPTOR = "[OTAUpdate:FirmwareDecryptor]";
+
+// Streaming AES-256-CTR decryption of pre-encrypted firmware images.
+//
+// The per-release key arrives wrapped (RFC 3394) with the fleet key-encryption
+// key provisioned in the encrypted NVS partition "fw_keys" ("keys" / "fw_kek"),
+// so a flash dump does not reveal it. With CONFIG_MBEDTLS_HARDWARE_AES
+// mbedtls_aes_* runs on the AES accelerator. CTR lets a resumed download
+// continue decrypting from any byte offset.
+class FirmwareDecryptor
+{
+public:
+    FirmwareDecryptor();
+    ~FirmwareDecryptor();
+
+    FirmwareDecryptor(const FirmwareDecryptor &) = delete;
+    FirmwareDecryptor &operator=(const FirmwareDecryptor &) = delete;
+
+    // False when the build has no KEK store: neither CONFIG_NVS_ENCRYPTION (for
+    // "fw_keys") nor OTA_KEK_PLAINTEXT_NVS. Encrypted commands are refused up front then.
+    static bool keyStoreAvailable();
+
+    // Unwraps the release key; `iv` is the 16-byte initial counter block
+    bool begin(const std::vector<uint8_t> &wrappedKey, const std::vector<uint8_t> &iv);
+
+    // Positions the keystream at byte `offset` of the image
+    void seek(uint32_t offset);
+
+    // Decrypts in place at the current position
+    bool decrypt(uint8_t *data, size_t len);
+
+private:
+    mbedtls_aes_context aes;
+    bool ready = false;
+    std::array<uint8_t, 16> initialCounter{};
+    std::array<uint8_t, 16> counter{};
+    std::array<uint8_t, 16> streamBlock{};
+    size_t streamOffset = 0;
+};
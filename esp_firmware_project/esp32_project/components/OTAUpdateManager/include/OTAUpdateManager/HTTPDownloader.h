@@ -5,6 +5,8 @@
 #include <functional>
 #include "esp_log.h"
 #include "esp_ota_ops.h"
+#include "esp_http_client.h"
+#include "FirmwareDecryptor.h"
 
 inline const char *TAG_OTA_HTTP_DOWNLOADER = "[OTAUpdate:HTTPDownloader]";
 
@@ -13,12 +15,83 @@ class HttpDownloader
 public:
     using LogCallback = std::function<void(const std::string &)>;
 
-    HttpDownloader();
+    // chunkSize is the size of the buffer used for each read -> esp_ota_write step.
+    // maxConnections > 1 allows fetching the image as ranges over parallel connections.
+    explicit HttpDownloader(size_t chunkSize = 1024, int maxConnections = 1);
 
-    bool downloadToPartition(const std::string &firmwareUrl,
+    // firmwareUrls are mirrors of the same image in the publisher's preference order.
+    // They are re-ranked by time to first byte; a stalled transfer resumes on the
+    // next mirror with a Range request. An empty signatureUrl skips the signature
+    // download (signature supplied inline). With a decryptor, each chunk is
+    // decrypted in place before esp_ota_write.
+    //
+    // With maxConnections > 1 the first request is open-ended. If the fastest mirror
+    // answers 206, its TTFB and the rate of the first kSegmentSize bytes decide: when
+    // one stream is faster the same response carries on; otherwise the rest is fetched
+    // in kSegmentSize ranges by up to maxConnections workers and reordered through a
+    // bounded buffer, so esp_ota_write still sees sequential data. Connections are
+    // added one at a time while each raises aggregate throughput and free heap allows.
+    bool downloadToPartition(const std::vector<std::string> &firmwareUrls,
                              const std::string &signatureUrl,
                              const esp_partition_t *partition,
                              esp_ota_handle_t *otaHandleOut,
                              uint32_t *firmwareSizeOut,
-                             std::vector<uint8_t> &signatureOut);
+                             std::vector<uint8_t> &signatureOut,
+                             FirmwareDecryptor *decryptor = nullptr);
+
+private:
+    enum class TransferResult
+    {
+        Complete,
+        Interrupted, // Retry from the current offset, possibly on another mirror
+        Fatal,
+    };
+
+    static constexpr int kProbeTimeoutMs = 5000;
+    static constexpr int kReadTimeoutMs = 10000;
+    static constexpr int64_t kStallWindowUs = 5000000;
+    static constexpr int64_t kMinBytesPerSec = 2048;
+
+    static constexpr uint32_t kSegmentSize = 16 * 1024;
+    static constexpr uint32_t kMinParallelSize = 8 * kSegmentSize; // Smaller images stay on one connection
+    static constexpr size_t kConnectionHeapCost = 32 * 1024;      // TLS session, buffers and worker stack
+    static constexpr size_t kHeapReserve = 32 * 1024;
+    static constexpr uint32_t kRampWindowSegments = 4;
+    static constexpr int kRangeWorkerStack = 8192;
+
+    struct ParallelFetch; // Shared between the writer and the range workers
+
+    size_t chunkSize;
+    int maxConnections;
+
+    std::vector<std::string> rankMirrors(const std::vector<std::string> &urls);
+    TransferResult streamToPartition(esp_http_client_handle_t client,
+                                     esp_ota_handle_t otaHandle,
+                                     std::vector<uint8_t> &buffer,
+                                     uint32_t totalSize,
+                                     uint32_t endOffset,
+                                     uint32_t *writtenInOut,
+                                     FirmwareDecryptor *decryptor);
+    // Starts the OTA write from an open-ended request on mirrors.front(), then stays on
+    // that stream or switches to fetchParallel as described above
+    TransferResult fetchAdaptive(const std::vector<std::string> &mirrors,
+                                 const esp_partition_t *partition,
+                                 esp_ota_handle_t *otaHandleOut,
+                                 std::vector<uint8_t> &buffer,
+                                 uint32_t *totalSizeOut,
+                                 uint32_t *writtenInOut,
+                                 bool *otaStartedOut,
+                                 FirmwareDecryptor *decryptor);
+    // Continues from *writtenInOut, which must be on a kSegmentSize boundary
+    TransferResult fetchParallel(const std::vector<std::string> &mirrors,
+                                 esp_ota_handle_t otaHandle,
+                                 uint32_t totalSize,
+                                 uint32_t *writtenInOut,
+                                 FirmwareDecryptor *decryptor);
+    static bool spawnRangeWorker(ParallelFetch &fetch, int index);
+    static bool fetchRange(esp_http_client_handle_t client, uint32_t first, uint32_t length, uint8_t *dst);
+    static void rangeWorker(void *arg);
+    bool downloadSignature(const std::string &signatureUrl,
+                           std::vector<uint8_t> &tempBuffer,
+                           std::vector<uint8_t> &signatureOut);
 };
@@ -0,0 +1,48 @@
+#pragma once
+
+#include <string>
+#include <mutex>
+#include <cstdint>
+#include "esp_partition.h"
+#include "esp_log.h"
+#include "NVSStorageHandler.h"
+
+inline const char *TAG_IMAGE_ATTESTOR = "[OTAUpdate:ImageAttestor]";
+
+// Proves which exact image the device runs: the SHA-256 of the running app image,
+// i.e. the same value deploy publishes as the release `checksum`.
+//
+// The digest is cached in NVS keyed by partition, image length and app ELF hash,
+// so a normal boot reads no flash. A low-priority background task recomputes it
+// through esp_partition_mmap in 64 KB spans, yielding between spans.
+class ImageAttestor
+{
+public:
+    static ImageAttestor &instance();
+
+    // Loads the cached digest and starts the background hashing task. Non-blocking.
+    void start();
+
+    // {"partition", "image_len", "image_sha256", "state", "nonce"}
+    std::string buildReport(const std::string &nonce);
+
+    // Hex SHA-256 of the running image, cached or recomputed; empty until one is known
+    std::string imageDigest();
+
+private:
+    static constexpr size_t kSpanSize = 64 * 1024;
+
+    ImageAttestor();
+
+    std::mutex mutex;
+    NVSStorageHandler nvs;
+    const esp_partition_t *partition = nullptr;
+    uint32_t imageLen = 0;
+    std::string cacheKey;
+    std::string digestHex;
+    bool verified = false; // Recomputed from flash during this boot
+    bool started = false;
+
+    static void taskEntry(void *arg);
+    bool computeDigest(uint8_t out[32]);
+};
@@ -1,5 +1,6 @@
 #pragma once
 #include <string>
+#include <vector>
 #include "nvs.h"
 #include "nvs_flash.h"
 #include "esp_log.h"
@@ -14,12 +15,20 @@ public:
     // Initialize the NVS partition
     bool begin();
 
+    // Initialize the partition with NVS encryption, keyed from the nvs_keys partition
+    bool beginEncrypted();
+
     // Get firmware version or return default
     std::string getFirmwareVersion(const std::string& defaultVersion = "0.0.0");
 
     // Store firmware version
     bool storeFirmwareVersion(const std::string& version);
 
+    // Generic binary records (keys are limited to 15 characters by NVS)
+    bool getBlob(const std::string& key, std::vector<uint8_t>& out);
+    bool storeBlob(const std::string& key, const std::vector<uint8_t>& data);
+    bool eraseKey(const std::string& key);
+
 private:
     std::string partition;
     std::string ns;
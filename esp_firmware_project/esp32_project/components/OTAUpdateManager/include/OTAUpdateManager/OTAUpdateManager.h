@@ -1,10 +1,14 @@
 #pragma once
 
 #include <string>
+#include <vector>
 #include <functional>
-#include "HttpDownloader.h"
+#include "HTTPDownloader.h"
 #include "SignatureVerifier.h"
 #include "NVSStorageHandler.h"
+#include "ActivationManager.h"
+#include "SlotIndex.h"
+#include "BootHealthCheck.h"
 #include "esp_log.h"
 
 inline const char *TAG_OTA_UPDATE = "[OTAUpdate]";
@@ -15,6 +19,18 @@ typedef struct {
 
 void ota_update_task(void *param);
 
+// Spawns ota_update_task only if the command's version is newer than the running
+// one (or already held by the inactive slot), no update is already in progress and
+// the running image has passed its health check, so retained re-deliveries stay cheap.
+bool ota_start_update_task(const char *data, int len);
+
+// Activates the staged firmware named by {"version": ...} (firmware_activate topics)
+bool ota_handle_activate_command(const char *data, int len);
+
+// Builds the status report published on connect and once a new image passes its health check:
+// {"version": ..., "checksum": ..., "encryption": bool, "staged": ..., "inactive_slot": ..., "health": {...}}
+std::string ota_build_status_report();
+
 class OtaUpdateManager
 {
 public:
@@ -22,8 +38,14 @@ public:
     {
         std::string version;
         std::string firmwareUrl;
+        std::vector<std::string> firmwareUrls; // Ranked mirrors; firmwareUrl is always the first entry
         std::string signatureUrl;
         std::string expectedChecksum;
+        std::vector<uint8_t> signature; // Inline signature (optional); skips the signature download
+        std::vector<uint8_t> wrappedKey; // Set for pre-encrypted (AES-256-CTR) images
+        std::vector<uint8_t> encryptionIv;
+        ActivationPolicy activation; // Defaults to immediate
+        bool rollback = false;       // Install even if older than the running version
     };
 
     using LogCallback = std::function<void(const std::string &)>;
@@ -34,10 +56,15 @@ public:
     const std::string &getCurrentVersion() const;
 
 private:
+    friend bool ota_start_update_task(const char *data, int len);
+
     std::string currentVersion;
     NVSStorageHandler nvsStorageHandler;
 
     bool isNewVersion(const std::string &newVersion);
+    static bool isNewerVersion(const std::string &candidate, const std::string &current);
+    // Newer than `current`, or any other version if the command is a rollback
+    static bool shouldInstall(const std::string &candidate, const std::string &current, bool rollback);
     bool parsePayload(const std::string &json, FirmwareMetadata &outMeta);
 
     bool performUpdate(const FirmwareMetadata &metadata);
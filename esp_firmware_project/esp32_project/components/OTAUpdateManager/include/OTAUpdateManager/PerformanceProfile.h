@@ -0,0 +1,34 @@
+#pragma once
+
+#include <cstdint>
+#include "esp_log.h"
+#include "esp_pm.h"
+#include "esp_wifi_types.h"
+
+inline const char *TAG_OTA_PERF_PROFILE = "[OTAUpdate:PerformanceProfile]";
+
+// Scoped performance profile for the update window: holds a max-CPU-frequency
+// PM lock and turns Wi-Fi power save off, restoring both on destruction.
+//
+// lwIP's TCP receive window is fixed at build time (CONFIG_LWIP_TCP_WND_DEFAULT),
+// so it is not touched here.
+class PerformanceProfile
+{
+public:
+    PerformanceProfile();
+    ~PerformanceProfile();
+
+    PerformanceProfile(const PerformanceProfile &) = delete;
+    PerformanceProfile &operator=(const PerformanceProfile &) = delete;
+
+    static uint32_t cpuFreqMhz();
+
+private:
+    static constexpr int kMaxCpuFreqMhz = 240;
+
+    esp_pm_lock_handle_t cpuLock = nullptr;
+    bool powerSaveChanged = false;
+    wifi_ps_type_t previousPowerSave = WIFI_PS_NONE;
+
+    static esp_err_t configureFrequencyScaling();
+};
@@ -1,6 +1,7 @@
 #pragma once
 
 #include <string>
+#include <vector>
 #include <functional>
 #include "esp_log.h"
 #include "esp_ota_ops.h"
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <cstdint>
+#include "esp_partition.h"
+#include "esp_log.h"
+#include "NVSStorageHandler.h"
+
+inline const char *TAG_OTA_SLOT_INDEX = "[OTAUpdate:SlotIndex]";
+
+// A verified image as it was written to an OTA slot
+struct SlotImage
+{
+    std::string version;
+    uint32_t imageSize = 0;
+    std::string checksum; // Lowercase hex SHA-256 of the first imageSize bytes
+    std::vector<uint8_t> signature;
+};
+
+// Records in NVS which verified image each OTA slot holds, so a command for a
+// version still present in the inactive slot (a rollback, or rolling forward
+// again) switches to it without downloading.
+//
+// A slot's entry is forgotten before the slot is erased and recorded only after
+// the image written to it has been verified.
+class SlotIndex
+{
+public:
+    SlotIndex();
+
+    bool lookup(const esp_partition_t *partition, SlotImage &out);
+    bool record(const esp_partition_t *partition, const SlotImage &image);
+    void forget(const esp_partition_t *partition);
+
+    // True if `partition` holds a verified image of `version`
+    bool holds(const esp_partition_t *partition, const std::string &version);
+
+private:
+    // Persisted as one NVS blob per slot, followed by the signature bytes
+    struct RecordHeader
+    {
+        uint32_t imageSize;
+        uint16_t signatureLen;
+        uint16_t reserved;
+        char version[32];
+        char checksum[64];
+    };
+
+    NVSStorageHandler nvs;
+
+    static std::string keyFor(const esp_partition_t *partition);
+};
@@ -0,0 +1,409 @@
+#include "OTAUpdateManager/ActivationManager.h"
+#include "OTAUpdateManager/BootHealthCheck.h"
+#include "OTAUpdateManager/SlotIndex.h"
+#include "esp_ota_ops.h"
+#include "esp_system.h"
+#include "esp_sntp.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include <cstddef>
+#include <cstring>
+#include <ctime>
+#include <vector>
+
+#define NVS_KEY_PENDING "pending"
+
+// Anything earlier means SNTP has not set the clock yet
+static constexpr time_t kMinValidTime = 1700000000;
+
+static const char *policyName(uint8_t policy)
+{
+    switch (static_cast<ActivationPolicy::Type>(policy))
+    {
+    case ActivationPolicy::Type::Immediate:
+        return "immediate";
+    case ActivationPolicy::Type::Window:
+        return "window";
+    case ActivationPolicy::Type::Command:
+        return "command";
+    case ActivationPolicy::Type::NextBoot:
+        return "next_boot";
+    }
+    return "unknown";
+}
+
+static bool inWindow(uint16_t startMin, uint16_t endMin, uint16_t nowMin)
+{
+    return startMin <= endMin ? (nowMin >= startMin && nowMin < endMin)
+                              : (nowMin >= startMin || nowMin < endMin);
+}
+
+// The bootloader marked the image invalid or aborted after booting it
+static bool rejectedAtBoot(uint32_t partitionAddress)
+{
+    const esp_partition_t *partition = esp_ota_get_next_update_partition(NULL);
+    esp_ota_img_states_t state;
+    return partition && partition->address == partitionAddress &&
+           esp_ota_get_state_partition(partition, &state) == ESP_OK &&
+           (state == ESP_OTA_IMG_INVALID || state == ESP_OTA_IMG_ABORTED);
+}
+
+// A rejected image must not be re-staged from its slot, or by a command still retained for it
+static void forgetRejected(uint32_t partitionAddress, const char *version)
+{
+    const esp_partition_t *partition = esp_ota_get_next_update_partition(NULL);
+    if (partition && partition->address == partitionAddress)
+    {
+        SlotIndex().forget(partition);
+    }
+    BootHealthCheck::instance().recordRollback(version);
+}
+
+ActivationManager &ActivationManager::instance()
+{
+    static ActivationManager manager;
+    return manager;
+}
+
+ActivationManager::ActivationManager() : nvs("nvs", "firmware") {}
+
+bool ActivationManager::loadRecord(PendingRecord &record)
+{
+    // Records staged by older firmware end before previousVersion
+    std::vector<uint8_t> blob;
+    if (!nvs.getBlob(NVS_KEY_PENDING, blob) || blob.size() > sizeof(record) ||
+        blob.size() < offsetof(PendingRecord, previousVersion))
+    {
+        return false;
+    }
+    record = {};
+    memcpy(&record, blob.data(), blob.size());
+    record.version[sizeof(record.version) - 1] = '\0';
+    record.previousVersion[sizeof(record.previousVersion) - 1] = '\0';
+    return true;
+}
+
+bool ActivationManager::storeRecord(const PendingRecord &record)
+{
+    const uint8_t *bytes = reinterpret_cast<const uint8_t *>(&record);
+    return nvs.storeBlob(NVS_KEY_PENDING, std::vector<uint8_t>(bytes, bytes + sizeof(record)));
+}
+
+void ActivationManager::clearRecord()
+{
+    nvs.eraseKey(NVS_KEY_PENDING);
+}
+
+void ActivationManager::finalizePendingActivation()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+
+    PendingRecord record;
+    if (!loadRecord(record))
+    {
+        return;
+    }
+
+    const esp_partition_t *running = esp_ota_get_running_partition();
+    const auto policy = static_cast<ActivationPolicy::Type>(record.policy);
+    if (running && running->address == record.partitionAddress)
+    {
+        esp_ota_img_states_t state = ESP_OTA_IMG_UNDEFINED;
+        esp_ota_get_state_partition(running, &state);
+        if (state == ESP_OTA_IMG_PENDING_VERIFY)
+        {
+            // Report the running version now, but keep the record until the health check passes
+            if (!(record.flags & kFlagTrial))
+            {
+                strncpy(record.previousVersion, nvs.getFirmwareVersion("1.0.0").c_str(),
+                        sizeof(record.previousVersion) - 1);
+                record.flags |= kFlagTrial;
+            }
+            if (storeRecord(record))
+            {
+                nvs.storeFirmwareVersion(record.version);
+                ESP_LOGI(TAG_OTA_ACTIVATION, "Firmware %s (%s) on trial until its health check passes",
+                         record.version, policyName(record.policy));
+                return;
+            }
+        }
+        nvs.storeFirmwareVersion(record.version);
+        clearRecord();
+        ESP_LOGI(TAG_OTA_ACTIVATION, "Activated firmware %s (%s)", record.version, policyName(record.policy));
+    }
+    else if (record.flags & kFlagTrial)
+    {
+        // The staged image booted but the bootloader rolled back to this one
+        if (record.previousVersion[0] != '\0')
+        {
+            nvs.storeFirmwareVersion(record.previousVersion);
+        }
+        forgetRejected(record.partitionAddress, record.version);
+        clearRecord();
+        ESP_LOGW(TAG_OTA_ACTIVATION, "Firmware %s failed its trial boot, rolled back to %s", record.version,
+                 record.previousVersion);
+    }
+    else if (policy == ActivationPolicy::Type::Immediate || policy == ActivationPolicy::Type::NextBoot)
+    {
+        // The boot partition was already switched, so the bootloader refused the new image
+        forgetRejected(record.partitionAddress, record.version);
+        clearRecord();
+        ESP_LOGW(TAG_OTA_ACTIVATION, "Staged firmware %s did not boot, discarding it", record.version);
+    }
+    else if (rejectedAtBoot(record.partitionAddress))
+    {
+        // Activated, then rejected before the trial was recorded; activating it again would loop
+        forgetRejected(record.partitionAddress, record.version);
+        clearRecord();
+        ESP_LOGW(TAG_OTA_ACTIVATION, "Staged firmware %s was rejected at boot, discarding it", record.version);
+    }
+    else
+    {
+        ESP_LOGI(TAG_OTA_ACTIVATION, "Firmware %s staged, awaiting %s activation", record.version,
+                 policyName(record.policy));
+    }
+}
+
+void ActivationManager::commitTrial()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+
+    PendingRecord record;
+    if (loadRecord(record) && (record.flags & kFlagTrial))
+    {
+        clearRecord();
+        ESP_LOGI(TAG_OTA_ACTIVATION, "Committed firmware %s", record.version);
+    }
+}
+
+std::string ActivationManager::trialVersion()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+
+    PendingRecord record;
+    return loadRecord(record) && (record.flags & kFlagTrial) ? std::string(record.version) : std::string();
+}
+
+void ActivationManager::start()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+
+    PendingRecord record;
+    if (loadRecord(record) && !(record.flags & kFlagTrial) &&
+        static_cast<ActivationPolicy::Type>(record.policy) == ActivationPolicy::Type::Window)
+    {
+        armWindow(record);
+    }
+}
+
+bool ActivationManager::stage(const esp_partition_t *partition, const std::string &version,
+                              const ActivationPolicy &policy)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+
+    PendingRecord record = {};
+    record.partitionAddress = partition->address;
+    record.policy = static_cast<uint8_t>(policy.type);
+    record.windowStartMin = policy.windowStartMin;
+    record.windowEndMin = policy.windowEndMin;
+    strncpy(record.version, version.c_str(), sizeof(record.version) - 1);
+
+    if (windowTimer)
+    {
+        esp_timer_stop(windowTimer); // A previously staged window no longer applies
+    }
+
+    if (!storeRecord(record))
+    {
+        ESP_LOGE(TAG_OTA_ACTIVATION, "Failed to record staged firmware %s", record.version);
+        return false;
+    }
+    ESP_LOGI(TAG_OTA_ACTIVATION, "Staged firmware %s in %s (%s)", record.version, partition->label,
+             policyName(record.policy));
+
+    switch (policy.type)
+    {
+    case ActivationPolicy::Type::Immediate:
+        return startActivation(record);
+    case ActivationPolicy::Type::Window:
+        armWindow(record);
+        return true;
+    case ActivationPolicy::Type::Command:
+        return true;
+    case ActivationPolicy::Type::NextBoot:
+        if (esp_ota_set_boot_partition(partition) != ESP_OK)
+        {
+            ESP_LOGE(TAG_OTA_ACTIVATION, "Failed to set boot partition");
+            clearRecord();
+            return false;
+        }
+        ESP_LOGI(TAG_OTA_ACTIVATION, "Boot partition set; firmware %s runs after the next reboot", record.version);
+        return true;
+    }
+    return false;
+}
+
+void ActivationManager::discard(const esp_partition_t *partition)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+
+    PendingRecord record;
+    if (!loadRecord(record) || record.partitionAddress != partition->address)
+    {
+        return;
+    }
+
+    // next_boot already pointed the bootloader at the slot about to be overwritten
+    if (static_cast<ActivationPolicy::Type>(record.policy) == ActivationPolicy::Type::NextBoot)
+    {
+        esp_ota_set_boot_partition(esp_ota_get_running_partition());
+    }
+    if (windowTimer)
+    {
+        esp_timer_stop(windowTimer);
+    }
+    clearRecord();
+    ESP_LOGI(TAG_OTA_ACTIVATION, "Discarded staged firmware %s", record.version);
+}
+
+bool ActivationManager::activate(const std::string &version)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+
+    PendingRecord record;
+    if (!loadRecord(record) || (record.flags & kFlagTrial))
+    {
+        ESP_LOGW(TAG_OTA_ACTIVATION, "Activate %s: no staged firmware", version.c_str());
+        return false;
+    }
+    if (version != record.version)
+    {
+        ESP_LOGW(TAG_OTA_ACTIVATION, "Activate %s: staged firmware is %s, ignoring", version.c_str(), record.version);
+        return false;
+    }
+    return startActivation(record);
+}
+
+bool ActivationManager::startActivation(const PendingRecord &record)
+{
+    bool expected = false;
+    if (!restarting.compare_exchange_strong(expected, true))
+    {
+        return true;
+    }
+
+    // Switching re-validates the whole image, so it runs off the caller's task
+    auto *params = new PendingRecord(record);
+    if (xTaskCreate(&ActivationManager::activateTask, "ota_activate", 4096, params, 5, NULL) != pdPASS)
+    {
+        ESP_LOGE(TAG_OTA_ACTIVATION, "Failed to create activation task");
+        delete params;
+        restarting = false;
+        return false;
+    }
+    return true;
+}
+
+void ActivationManager::activateTask(void *arg)
+{
+    PendingRecord *record = static_cast<PendingRecord *>(arg);
+    ActivationManager &self = instance();
+
+    const esp_partition_t *partition = esp_ota_get_next_update_partition(NULL);
+    if (!partition || partition->address != record->partitionAddress ||
+        esp_ota_set_boot_partition(partition) != ESP_OK)
+    {
+        ESP_LOGE(TAG_OTA_ACTIVATION, "Staged firmware %s is no longer valid, discarding it", record->version);
+        {
+            std::lock_guard<std::mutex> lock(self.mutex);
+            self.clearRecord();
+        }
+        self.restarting = false;
+        delete record;
+        vTaskDelete(NULL);
+        return;
+    }
+    ESP_LOGI(TAG_OTA_ACTIVATION, "Boot partition set to firmware %s", record->version);
+    delete record;
+
+    ESP_LOGI(TAG_OTA_ACTIVATION, " Restarting device... 3");
+    vTaskDelay(pdMS_TO_TICKS(1000));
+    ESP_LOGI(TAG_OTA_ACTIVATION, " Restarting device... 2");
+    vTaskDelay(pdMS_TO_TICKS(1000));
+    ESP_LOGI(TAG_OTA_ACTIVATION, " Restarting device... 1");
+    vTaskDelay(pdMS_TO_TICKS(1000));
+    esp_restart();
+}
+
+void ActivationManager::armWindow(const PendingRecord &record)
+{
+    if (!esp_sntp_enabled())
+    {
+        esp_sntp_setoperatingmode(ESP_SNTP_OPMODE_POLL);
+        esp_sntp_setservername(0, "pool.ntp.org");
+        esp_sntp_init();
+    }
+
+    if (!windowTimer)
+    {
+        esp_timer_create_args_t args = {};
+        args.callback = &ActivationManager::onWindowTick;
+        args.arg = this;
+        args.name = "ota_window";
+        if (esp_timer_create(&args, &windowTimer) != ESP_OK)
+        {
+            ESP_LOGE(TAG_OTA_ACTIVATION, "Failed to create activation window timer");
+            return;
+        }
+    }
+
+    esp_timer_stop(windowTimer);
+    esp_timer_start_periodic(windowTimer, kWindowPollUs);
+    ESP_LOGI(TAG_OTA_ACTIVATION, "Firmware %s activates between %02u:%02u and %02u:%02u UTC", record.version,
+             record.windowStartMin / 60, record.windowStartMin % 60, record.windowEndMin / 60,
+             record.windowEndMin % 60);
+}
+
+void ActivationManager::onWindowTick(void *arg)
+{
+    ActivationManager &self = *static_cast<ActivationManager *>(arg);
+
+    PendingRecord record;
+    {
+        std::lock_guard<std::mutex> lock(self.mutex);
+        if (!self.loadRecord(record) ||
+            static_cast<ActivationPolicy::Type>(record.policy) != ActivationPolicy::Type::Window)
+        {
+            esp_timer_stop(self.windowTimer);
+            return;
+        }
+    }
+
+    time_t now = time(nullptr);
+    if (now < kMinValidTime)
+    {
+        ESP_LOGD(TAG_OTA_ACTIVATION, "Waiting for SNTP before checking the activation window");
+        return;
+    }
+
+    struct tm utc;
+    gmtime_r(&now, &utc);
+    if (inWindow(record.windowStartMin, record.windowEndMin, utc.tm_hour * 60 + utc.tm_min))
+    {
+        esp_timer_stop(self.windowTimer);
+        self.activate(record.version);
+    }
+}
+
+std::string ActivationManager::pendingVersion()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+
+    PendingRecord record;
+    return loadRecord(record) && !(record.flags & kFlagTrial) ? std::string(record.version) : std::string();
+}
+
+bool ActivationManager::restartScheduled() const
+{
+    return restarting;
+}
@@ -0,0 +1,239 @@
+#include "OTAUpdateManager/BootHealthCheck.h"
+#include "OTAUpdateManager/ActivationManager.h"
+#include "esp_ota_ops.h"
+#include "esp_app_desc.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include <ArduinoJson.h>
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <inttypes.h>
+#include <vector>
+
+#define NVS_KEY_HEALTH "health"
+
+BootHealthCheck &BootHealthCheck::instance()
+{
+    static BootHealthCheck check;
+    return check;
+}
+
+BootHealthCheck::BootHealthCheck() : nvs("nvs", "firmware") {}
+
+const char *BootHealthCheck::stageName(uint8_t stage)
+{
+    switch (static_cast<Stage>(stage))
+    {
+    case Stage::Boot:
+        return "boot";
+    case Stage::Ip:
+        return "ip";
+    case Stage::Mqtt:
+        return "mqtt";
+    case Stage::Subscribed:
+        return "subscribed";
+    }
+    return "unknown";
+}
+
+void BootHealthCheck::begin(uint32_t deadline)
+{
+    const esp_partition_t *running = esp_ota_get_running_partition();
+    esp_ota_img_states_t state;
+    if (!running || esp_ota_get_state_partition(running, &state) != ESP_OK || state != ESP_OTA_IMG_PENDING_VERIFY)
+    {
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (armed)
+        {
+            return;
+        }
+        armed = true;
+        deadlineMs = deadline;
+        version = ActivationManager::instance().trialVersion();
+        if (version.empty())
+        {
+            version = esp_app_get_description()->version;
+        }
+    }
+    ESP_LOGI(TAG_OTA_HEALTH, "Firmware %s pending verification: must be healthy within %" PRIu32 " ms of boot",
+             version.c_str(), deadlineMs);
+
+    // Without the task there is no deadline, but a reset still rolls back in the bootloader
+    if (xTaskCreate(&BootHealthCheck::deadlineTask, "ota_health", 4096, this, 5, NULL) != pdPASS)
+    {
+        ESP_LOGE(TAG_OTA_HEALTH, "Failed to create health check task");
+    }
+}
+
+void BootHealthCheck::advance(Stage reached)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    if (armed && !healthy && !expired && reached > stage)
+    {
+        stage = reached;
+        ESP_LOGI(TAG_OTA_HEALTH, "Reached %s %" PRId64 " ms after boot", stageName(static_cast<uint8_t>(reached)),
+                 esp_timer_get_time() / 1000);
+    }
+}
+
+void BootHealthCheck::onGotIp()
+{
+    advance(Stage::Ip);
+}
+
+void BootHealthCheck::onMqttConnected(int firmwareTopicMsgId)
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        expectedMsgId = firmwareTopicMsgId; // A reconnect subscribes again under a new id
+    }
+    advance(Stage::Mqtt);
+}
+
+bool BootHealthCheck::onSubscribed(int msgId, bool granted)
+{
+    uint32_t elapsedMs = 0;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (!armed || healthy || expired || msgId < 0 || msgId != expectedMsgId)
+        {
+            return false;
+        }
+        if (!granted)
+        {
+            ESP_LOGE(TAG_OTA_HEALTH, "Broker refused the firmware topic subscription");
+            return false;
+        }
+        healthy = true;
+        stage = Stage::Subscribed;
+        elapsedMs = static_cast<uint32_t>(esp_timer_get_time() / 1000);
+        cv.notify_all();
+    }
+
+    if (esp_ota_mark_app_valid_cancel_rollback() != ESP_OK)
+    {
+        ESP_LOGE(TAG_OTA_HEALTH, "Failed to mark firmware %s valid", version.c_str());
+    }
+    ActivationManager::instance().commitTrial();
+    storeOutcome(true, elapsedMs);
+    ESP_LOGI(TAG_OTA_HEALTH, "Firmware %s healthy %" PRIu32 " ms after boot, marked valid", version.c_str(),
+             elapsedMs);
+    return true;
+}
+
+void BootHealthCheck::deadlineTask(void *arg)
+{
+    BootHealthCheck &self = *static_cast<BootHealthCheck *>(arg);
+
+    // The deadline counts from boot, like the reported boot-to-healthy time
+    std::unique_lock<std::mutex> lock(self.mutex);
+    const int64_t remainingUs = std::max<int64_t>(0, static_cast<int64_t>(self.deadlineMs) * 1000 -
+                                                         esp_timer_get_time());
+    if (self.cv.wait_for(lock, std::chrono::microseconds(remainingUs), [&]
+                         { return self.healthy; }))
+    {
+        lock.unlock();
+        vTaskDelete(NULL);
+        return;
+    }
+    self.expired = true; // A late acknowledgement must not mark the image valid
+    const Stage reached = self.stage;
+    lock.unlock();
+
+    self.storeOutcome(false, self.deadlineMs);
+    ESP_LOGE(TAG_OTA_HEALTH, "Firmware %s not healthy within %" PRIu32 " ms (reached %s), rolling back",
+             self.version.c_str(), self.deadlineMs, stageName(static_cast<uint8_t>(reached)));
+    esp_ota_mark_app_invalid_rollback_and_reboot();
+
+    // Only returns if there is no image to roll back to
+    ESP_LOGE(TAG_OTA_HEALTH, "Rollback failed, keeping firmware %s", self.version.c_str());
+    vTaskDelete(NULL);
+}
+
+void BootHealthCheck::storeOutcome(bool passed, uint32_t elapsedMs)
+{
+    OutcomeRecord record = {};
+    record.passed = passed ? 1 : 0;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        record.stage = static_cast<uint8_t>(stage);
+    }
+    record.elapsedMs = elapsedMs;
+    strncpy(record.version, version.c_str(), sizeof(record.version) - 1);
+    writeOutcome(record);
+}
+
+void BootHealthCheck::recordRollback(const std::string &rejected)
+{
+    OutcomeRecord record;
+    if (loadOutcome(record) && !record.passed && rejected == record.version)
+    {
+        return; // Written by the deadline, which knows the stage reached
+    }
+
+    record = {};
+    record.stage = kStageUnknown;
+    strncpy(record.version, rejected.c_str(), sizeof(record.version) - 1);
+    writeOutcome(record);
+}
+
+bool BootHealthCheck::rolledBack(const std::string &candidate)
+{
+    OutcomeRecord record;
+    return loadOutcome(record) && !record.passed && candidate == record.version;
+}
+
+bool BootHealthCheck::loadOutcome(OutcomeRecord &record)
+{
+    std::vector<uint8_t> blob;
+    if (!nvs.getBlob(NVS_KEY_HEALTH, blob) || blob.size() != sizeof(record))
+    {
+        return false;
+    }
+    memcpy(&record, blob.data(), sizeof(record));
+    record.version[sizeof(record.version) - 1] = '\0';
+    return true;
+}
+
+void BootHealthCheck::writeOutcome(const OutcomeRecord &record)
+{
+    const uint8_t *bytes = reinterpret_cast<const uint8_t *>(&record);
+    if (!nvs.storeBlob(NVS_KEY_HEALTH, std::vector<uint8_t>(bytes, bytes + sizeof(record))))
+    {
+        ESP_LOGW(TAG_OTA_HEALTH, "Failed to record health check outcome");
+    }
+}
+
+bool BootHealthCheck::pending()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return armed && !healthy;
+}
+
+std::string BootHealthCheck::lastOutcomeJson()
+{
+    OutcomeRecord record;
+    if (!loadOutcome(record))
+    {
+        return std::string();
+    }
+
+    StaticJsonDocument<192> doc;
+    doc["version"] = record.version;
+    doc["result"] = record.passed ? "passed" : "rolled_back";
+    doc["stage"] = stageName(record.stage);
+    if (record.stage != kStageUnknown)
+    {
+        doc["ms"] = record.elapsedMs;
+    }
+
+    std::string out;
+    serializeJson(doc, out);
+    return out;
+}
@@ -0,0 +1,130 @@
+#include "OTAUpdateManager/FirmwareDecryptor.h"
+#include "OTAUpdateManager/NVSStorageHandler.h"
+#include "mbedtls/nist_kw.h"
+#include "mbedtls/platform_util.h"
+#include "sdkconfig.h"
+#include <algorithm>
+#include <inttypes.h>
+
+#define NVS_PARTITION_KEYS "fw_keys"
+#define NVS_NAMESPACE_KEYS "keys"
+#define NVS_KEY_FIRMWARE_KEK "fw_kek"
+
+// Development boards without flash encryption: read the KEK from the plaintext "nvs" partition
+#ifndef OTA_KEK_PLAINTEXT_NVS
+#define OTA_KEK_PLAINTEXT_NVS 0
+#endif
+
+bool FirmwareDecryptor::keyStoreAvailable()
+{
+#if OTA_KEK_PLAINTEXT_NVS || CONFIG_NVS_ENCRYPTION
+    return true;
+#else
+    return false;
+#endif
+}
+
+FirmwareDecryptor::FirmwareDecryptor()
+{
+    mbedtls_aes_init(&aes);
+}
+
+FirmwareDecryptor::~FirmwareDecryptor()
+{
+    mbedtls_aes_free(&aes);
+}
+
+bool FirmwareDecryptor::begin(const std::vector<uint8_t> &wrappedKey, const std::vector<uint8_t> &iv)
+{
+    ready = false;
+    if (iv.size() != initialCounter.size())
+    {
+        ESP_LOGE(TAG_OTA_DECRYPTOR, "Invalid IV length: %zu", iv.size());
+        return false;
+    }
+
+    std::vector<uint8_t> kek;
+#if OTA_KEK_PLAINTEXT_NVS
+    ESP_LOGW(TAG_OTA_DECRYPTOR, "Reading the firmware KEK from plaintext NVS");
+    NVSStorageHandler keys("nvs", NVS_NAMESPACE_KEYS);
+    const bool opened = keys.begin();
+#else
+    NVSStorageHandler keys(NVS_PARTITION_KEYS, NVS_NAMESPACE_KEYS);
+    const bool opened = keys.beginEncrypted();
+#endif
+    if (!opened || !keys.getBlob(NVS_KEY_FIRMWARE_KEK, kek) || kek.size() != 32)
+    {
+        ESP_LOGE(TAG_OTA_DECRYPTOR, "Firmware key-encryption key not provisioned");
+        return false;
+    }
+
+    uint8_t releaseKey[32];
+    size_t releaseKeyLen = 0;
+    mbedtls_nist_kw_context kw;
+    mbedtls_nist_kw_init(&kw);
+    int ret = mbedtls_nist_kw_setkey(&kw, MBEDTLS_CIPHER_ID_AES, kek.data(), kek.size() * 8, 0);
+    if (ret == 0)
+    {
+        ret = mbedtls_nist_kw_unwrap(&kw, MBEDTLS_KW_MODE_KW, wrappedKey.data(), wrappedKey.size(),
+                                     releaseKey, &releaseKeyLen, sizeof(releaseKey));
+    }
+    mbedtls_nist_kw_free(&kw);
+    mbedtls_platform_zeroize(kek.data(), kek.size());
+
+    if (ret != 0 || releaseKeyLen != sizeof(releaseKey))
+    {
+        ESP_LOGE(TAG_OTA_DECRYPTOR, "Release key unwrap failed: -0x%04x", (unsigned)-ret);
+        mbedtls_platform_zeroize(releaseKey, sizeof(releaseKey));
+        return false;
+    }
+
+    // CTR only ever runs the block cipher forwards
+    ret = mbedtls_aes_setkey_enc(&aes, releaseKey, 256);
+    mbedtls_platform_zeroize(releaseKey, sizeof(releaseKey));
+    if (ret != 0)
+    {
+        ESP_LOGE(TAG_OTA_DECRYPTOR, "mbedtls_aes_setkey_enc failed: -0x%04x", (unsigned)-ret);
+        return false;
+    }
+
+    std::copy(iv.begin(), iv.end(), initialCounter.begin());
+    ready = true;
+    seek(0);
+    return true;
+}
+
+void FirmwareDecryptor::seek(uint32_t offset)
+{
+    // counter = IV + offset / 16, as a 128-bit big-endian integer
+    counter = initialCounter;
+    uint64_t carry = offset / 16;
+    for (int i = 15; i >= 0 && carry; --i)
+    {
+        carry += counter[i];
+        counter[i] = static_cast<uint8_t>(carry);
+        carry >>= 8;
+    }
+
+    streamOffset = 0;
+    uint8_t skip[16] = {0};
+    if (ready && offset % 16)
+    {
+        // Consume the head of the partial block so the next byte lines up with `offset`
+        mbedtls_aes_crypt_ctr(&aes, offset % 16, &streamOffset, counter.data(), streamBlock.data(), skip, skip);
+    }
+}
+
+bool FirmwareDecryptor::decrypt(uint8_t *data, size_t len)
+{
+    if (!ready)
+    {
+        return false;
+    }
+    int ret = mbedtls_aes_crypt_ctr(&aes, len, &streamOffset, counter.data(), streamBlock.data(), data, data);
+    if (ret != 0)
+    {
+        ESP_LOGE(TAG_OTA_DECRYPTOR, "mbedtls_aes_crypt_ctr failed: -0x%04x", (unsigned)-ret);
+        return false;
+    }
+    return true;
+}
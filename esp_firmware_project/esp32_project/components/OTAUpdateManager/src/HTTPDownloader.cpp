@@ -1,37 +1,52 @@
 #include "OTAUpdateManager/OTAUpdateManager.h"
 #include "esp_http_client.h"
 #include <cstring>
+#include <algorithm>
 #include "Common/certificates.h"
+#include "Common/CredentialStore.h"
 #include <sys/stat.h>
 #include "esp_log.h"
 #include "esp_ota_ops.h"
+#include "esp_timer.h"
+#include "esp_system.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
 #include <unistd.h>
 #include <inttypes.h>
+#include <strings.h>
+#include <mutex>
+#include <condition_variable>
 
 #define FIRMWARE_API_KEY "......................................."
 
-HttpDownloader::HttpDownloader() {}
-
-bool HttpDownloader::downloadToPartition(const std::string &firmwareUrl,
-                                         const std::string &signatureUrl,
-                                         const esp_partition_t *partition,
-                                         esp_ota_handle_t *otaHandleOut,
-                                         uint32_t *firmwareSizeOut,
-                                         std::vector<uint8_t> &signatureOut)
+// Uses the shared global CA store when available instead of re-parsing the PEM per connection
+static void applyTlsConfig(esp_http_client_config_t &config)
 {
-    ESP_LOGI(TAG_OTA_HTTP_DOWNLOADER, "Starting firmware download from URL: %s", firmwareUrl.c_str());
+    config.transport_type = HTTP_TRANSPORT_OVER_SSL;
+    if (CredentialStore::instance().hasGlobalCaStore())
+    {
+        config.use_global_ca_store = true;
+    }
+    else
+    {
+        config.cert_pem = AWS_CA_CERT;
+    }
+}
 
+// Creates a firmware client with its auth headers set. Returns null on failure.
+static esp_http_client_handle_t createFirmwareClient(const std::string &url, int timeoutMs)
+{
     esp_http_client_config_t fw_config = {};
-    fw_config.url = firmwareUrl.c_str();
-    fw_config.transport_type = HTTP_TRANSPORT_OVER_SSL;
-    fw_config.cert_pem = AWS_CA_CERT;
+    fw_config.url = url.c_str();
+    applyTlsConfig(fw_config);
     fw_config.disable_auto_redirect = true;
+    fw_config.timeout_ms = timeoutMs;
 
     esp_http_client_handle_t client = esp_http_client_init(&fw_config);
     if (!client)
     {
         ESP_LOGE(TAG_OTA_HTTP_DOWNLOADER, "Failed to init HTTP client for firmware");
-        return false;
+        return nullptr;
     }
 
     if (esp_http_client_set_header(client, "x-api-key", FIRMWARE_API_KEY) != ESP_OK ||
@@ -39,94 +54,696 @@ bool HttpDownloader::downloadToPartition(const std::string &firmwareUrl,
     {
         ESP_LOGE(TAG_OTA_HTTP_DOWNLOADER, "Failed to set firmware request headers");
         esp_http_client_cleanup(client);
-        return false;
+        return nullptr;
+    }
+    return client;
+}
+
+// Opens a firmware request and fetches its headers. `range` may be null.
+// Returns null on failure; otherwise the caller owns the open client.
+static esp_http_client_handle_t openFirmwareRequest(const std::string &url, const char *range, int timeoutMs,
+                                                    int64_t *contentLengthOut, int *statusOut)
+{
+    esp_http_client_handle_t client = createFirmwareClient(url, timeoutMs);
+    if (!client)
+    {
+        return nullptr;
+    }
+
+    if (range && esp_http_client_set_header(client, "Range", range) != ESP_OK)
+    {
+        ESP_LOGE(TAG_OTA_HTTP_DOWNLOADER, "Failed to set firmware request headers");
+        esp_http_client_cleanup(client);
+        return nullptr;
     }
 
     if (esp_http_client_open(client, 0) != ESP_OK)
     {
-        ESP_LOGE(TAG_OTA_HTTP_DOWNLOADER, "Failed to open firmware HTTP connection");
+        ESP_LOGE(TAG_OTA_HTTP_DOWNLOADER, "Failed to open firmware HTTP connection: %s", url.c_str());
         esp_http_client_cleanup(client);
-        return false;
+        return nullptr;
     }
 
-    // ---- Firmware Download ----
-    int content_length = esp_http_client_fetch_headers(client);
-    if (content_length <= 0)
+    *contentLengthOut = esp_http_client_fetch_headers(client);
+    *statusOut = esp_http_client_get_status_code(client);
+    if (*contentLengthOut <= 0 || (*statusOut != 200 && *statusOut != 206))
     {
-        ESP_LOGE(TAG_OTA_HTTP_DOWNLOADER, "Invalid firmware content length: %d", content_length);
+        ESP_LOGE(TAG_OTA_HTTP_DOWNLOADER, "Unexpected firmware response: status %d, length %" PRId64,
+                 *statusOut, *contentLengthOut);
         esp_http_client_close(client);
         esp_http_client_cleanup(client);
+        return nullptr;
+    }
+
+    return client;
+}
+
+static void closeRequest(esp_http_client_handle_t client)
+{
+    esp_http_client_close(client);
+    esp_http_client_cleanup(client);
+}
+
+// Per-chunk INFO logs over UART cost more than the chunk itself; report every 10%
+static void logProgress(uint32_t written, uint32_t totalSize, uint32_t *loggedDecile)
+{
+    uint32_t decile = static_cast<uint64_t>(written) * 10 / totalSize;
+    if (decile != *loggedDecile)
+    {
+        *loggedDecile = decile;
+        ESP_LOGI(TAG_OTA_HTTP_DOWNLOADER, "Firmware download %" PRIu32 "%% (%" PRIu32 "/%" PRIu32 " bytes)",
+                 decile * 10, written, totalSize);
+    }
+}
+
+struct HttpDownloader::ParallelFetch
+{
+    ParallelFetch(const std::vector<std::string> &mirrors, uint32_t totalSize, uint32_t firstSegment, size_t slotCount)
+        : mirrors(mirrors), totalSize(totalSize), segmentCount((totalSize + kSegmentSize - 1) / kSegmentSize),
+          slots(slotCount, std::vector<uint8_t>(kSegmentSize)), ready(slotCount, false), nextSegment(firstSegment),
+          writtenSegments(firstSegment) {}
+
+    uint32_t segmentLength(uint32_t segment) const
+    {
+        return std::min<uint32_t>(kSegmentSize, totalSize - segment * kSegmentSize);
+    }
+
+    const std::vector<std::string> &mirrors;
+    const uint32_t totalSize;
+    const uint32_t segmentCount;
+    std::vector<std::vector<uint8_t>> slots; // Reorder buffer: segment i waits in slots[i % slots.size()]
+    std::vector<bool> ready;
+
+    std::mutex mutex;
+    std::condition_variable cv;
+    uint32_t nextSegment;     // Next segment a worker claims
+    uint32_t writtenSegments; // Segments already passed to esp_ota_write, in order
+    int activeLimit = 0;          // Workers at or above this index exit at their next claim
+    int running = 0;
+    bool failed = false; // A segment could not be fetched from any mirror
+    bool stop = false;
+};
+
+HttpDownloader::HttpDownloader(size_t chunkSize, int maxConnections)
+    : chunkSize(chunkSize), maxConnections(std::max(1, maxConnections)) {}
+
+std::vector<std::string> HttpDownloader::rankMirrors(const std::vector<std::string> &urls)
+{
+    if (urls.size() < 2)
+    {
+        return urls;
+    }
+
+    // Time to first byte of a one-byte range request; unreachable mirrors sort last
+    struct Probe
+    {
+        int64_t ttfb;
+        std::string url;
+    };
+    std::vector<Probe> ranked;
+    for (const std::string &url : urls)
+    {
+        int64_t start = esp_timer_get_time();
+        int64_t length = 0;
+        int status = 0;
+        esp_http_client_handle_t client = openFirmwareRequest(url, "bytes=0-0", kProbeTimeoutMs, &length, &status);
+        int64_t ttfb = client ? esp_timer_get_time() - start : INT64_MAX;
+        if (client)
+        {
+            closeRequest(client);
+        }
+
+        ESP_LOGI(TAG_OTA_HTTP_DOWNLOADER, "Mirror %s: TTFB %" PRId64 " ms", url.c_str(),
+                 ttfb == INT64_MAX ? -1 : ttfb / 1000);
+        ranked.push_back({ttfb, url});
+    }
+
+    // Stable: equal probes keep the publisher's preference order
+    std::stable_sort(ranked.begin(), ranked.end(), [](const Probe &a, const Probe &b)
+                     { return a.ttfb < b.ttfb; });
+
+    std::vector<std::string> out;
+    for (auto &entry : ranked)
+    {
+        out.push_back(entry.url);
+    }
+    return out;
+}
+
+HttpDownloader::TransferResult HttpDownloader::streamToPartition(esp_http_client_handle_t client,
+                                                                 esp_ota_handle_t otaHandle,
+                                                                 std::vector<uint8_t> &buffer,
+                                                                 uint32_t totalSize,
+                                                                 uint32_t endOffset,
+                                                                 uint32_t *writtenInOut,
+                                                                 FirmwareDecryptor *decryptor)
+{
+    int64_t windowStart = esp_timer_get_time();
+    uint32_t windowBytes = 0;
+    uint32_t loggedDecile = static_cast<uint64_t>(*writtenInOut) * 10 / totalSize;
+
+    while (*writtenInOut < endOffset)
+    {
+        int toRead = std::min<uint32_t>(buffer.size(), endOffset - *writtenInOut);
+        int read_bytes = esp_http_client_read(client, (char *)buffer.data(), toRead);
+        if (read_bytes < 0)
+        {
+            ESP_LOGW(TAG_OTA_HTTP_DOWNLOADER, "HTTP read error/timeout at offset %" PRIu32, *writtenInOut);
+            return TransferResult::Interrupted;
+        }
+        else if (read_bytes == 0)
+        {
+            ESP_LOGW(TAG_OTA_HTTP_DOWNLOADER, "Connection closed early at offset %" PRIu32, *writtenInOut);
+            return TransferResult::Interrupted;
+        }
+
+        if (decryptor && !decryptor->decrypt(buffer.data(), read_bytes))
+        {
+            return TransferResult::Fatal;
+        }
+
+        esp_err_t err = esp_ota_write(otaHandle, buffer.data(), read_bytes);
+        if (err != ESP_OK)
+        {
+            ESP_LOGE(TAG_OTA_HTTP_DOWNLOADER, "esp_ota_write failed at offset %" PRIu32 ": %s", *writtenInOut, esp_err_to_name(err));
+            return TransferResult::Fatal;
+        }
+        *writtenInOut += read_bytes;
+        windowBytes += read_bytes;
+        ESP_LOGD(TAG_OTA_HTTP_DOWNLOADER, "Firmware chunk written: %d bytes, total: %" PRIu32, read_bytes, *writtenInOut);
+        logProgress(*writtenInOut, totalSize, &loggedDecile);
+
+        int64_t now = esp_timer_get_time();
+        if (now - windowStart >= kStallWindowUs)
+        {
+            int64_t bytesPerSec = static_cast<int64_t>(windowBytes) * 1000000 / (now - windowStart);
+            if (bytesPerSec < kMinBytesPerSec)
+            {
+                ESP_LOGW(TAG_OTA_HTTP_DOWNLOADER, "Throughput stalled at %" PRId64 " B/s (offset %" PRIu32 ")",
+                         bytesPerSec, *writtenInOut);
+                return TransferResult::Interrupted;
+            }
+            windowStart = now;
+            windowBytes = 0;
+        }
+    }
+    return TransferResult::Complete;
+}
+
+bool HttpDownloader::fetchRange(esp_http_client_handle_t client, uint32_t first, uint32_t length, uint8_t *dst)
+{
+    char range[40];
+    snprintf(range, sizeof(range), "bytes=%" PRIu32 "-%" PRIu32, first, first + length - 1);
+    if (esp_http_client_set_header(client, "Range", range) != ESP_OK)
+    {
         return false;
     }
 
-    int status_code = esp_http_client_get_status_code(client);
-    if (status_code != 200 && status_code != 206)
+    // The connection is kept alive between ranges; reopen it if the server closed it
+    if (esp_http_client_open(client, 0) != ESP_OK)
     {
-        ESP_LOGE(TAG_OTA_HTTP_DOWNLOADER, "Unexpected firmware HTTP status code: %d", status_code);
         esp_http_client_close(client);
-        esp_http_client_cleanup(client);
+        if (esp_http_client_open(client, 0) != ESP_OK)
+        {
+            ESP_LOGW(TAG_OTA_HTTP_DOWNLOADER, "Failed to open range %s", range);
+            return false;
+        }
+    }
+
+    int64_t contentLength = esp_http_client_fetch_headers(client);
+    int status = esp_http_client_get_status_code(client);
+    if (status != 206 || contentLength != static_cast<int64_t>(length))
+    {
+        ESP_LOGW(TAG_OTA_HTTP_DOWNLOADER, "Unexpected response to range %s: status %d, length %" PRId64, range,
+                 status, contentLength);
         return false;
     }
 
-    ESP_LOGI(TAG_OTA_HTTP_DOWNLOADER, "Firmware HTTP response OK, size: %d bytes", content_length);
+    int64_t start = esp_timer_get_time();
+    uint32_t received = 0;
+    while (received < length)
+    {
+        int read_bytes = esp_http_client_read(client, reinterpret_cast<char *>(dst) + received, length - received);
+        if (read_bytes <= 0)
+        {
+            ESP_LOGW(TAG_OTA_HTTP_DOWNLOADER, "Range %s interrupted after %" PRIu32 " bytes", range, received);
+            return false;
+        }
+        received += read_bytes;
 
-    esp_err_t err = esp_ota_begin(partition, content_length, otaHandleOut);
-    if (err != ESP_OK)
+        int64_t elapsed = esp_timer_get_time() - start;
+        if (elapsed >= kStallWindowUs && static_cast<int64_t>(received) * 1000000 / elapsed < kMinBytesPerSec)
+        {
+            ESP_LOGW(TAG_OTA_HTTP_DOWNLOADER, "Range %s stalled", range);
+            return false;
+        }
+    }
+    return true;
+}
+
+bool HttpDownloader::spawnRangeWorker(ParallelFetch &fetch, int index)
+{
     {
-        ESP_LOGE(TAG_OTA_HTTP_DOWNLOADER, "esp_ota_begin failed: %s", esp_err_to_name(err));
-        esp_http_client_close(client);
-        esp_http_client_cleanup(client);
+        std::lock_guard<std::mutex> lock(fetch.mutex);
+        ++fetch.running;
+        fetch.activeLimit = index + 1;
+    }
+
+    auto *args = new std::pair<ParallelFetch *, int>(&fetch, index);
+    if (xTaskCreate(&HttpDownloader::rangeWorker, "ota_range", kRangeWorkerStack, args, 5, NULL) != pdPASS)
+    {
+        ESP_LOGE(TAG_OTA_HTTP_DOWNLOADER, "Failed to create range worker %d", index);
+        delete args;
+        std::lock_guard<std::mutex> lock(fetch.mutex);
+        --fetch.running;
+        fetch.activeLimit = index;
         return false;
     }
+    return true;
+}
+
+void HttpDownloader::rangeWorker(void *arg)
+{
+    auto *args = static_cast<std::pair<ParallelFetch *, int> *>(arg);
+    ParallelFetch &fetch = *args->first;
+    const int index = args->second;
+    delete args;
+
+    size_t mirror = 0; // Advances to the next ranked mirror after a failed range
+    esp_http_client_handle_t client = nullptr;
 
-    uint8_t tempBuffer[1024];
-    int total_written = 0;
     while (true)
     {
-        int read_bytes = esp_http_client_read(client, (char *)tempBuffer, sizeof(tempBuffer));
-        if (read_bytes < 0)
+        uint32_t segment = 0;
         {
-            ESP_LOGE(TAG_OTA_HTTP_DOWNLOADER, "HTTP read error during firmware download");
-            esp_http_client_close(client);
-            esp_http_client_cleanup(client);
-            return false;
+            // Claim the next segment once its reorder slot has been written out
+            std::unique_lock<std::mutex> lock(fetch.mutex);
+            fetch.cv.wait(lock, [&]
+                          { return fetch.stop || fetch.failed || index >= fetch.activeLimit ||
+                                   fetch.nextSegment >= fetch.segmentCount ||
+                                   fetch.nextSegment < fetch.writtenSegments + fetch.slots.size(); });
+            if (fetch.stop || fetch.failed || index >= fetch.activeLimit || fetch.nextSegment >= fetch.segmentCount)
+            {
+                break;
+            }
+            segment = fetch.nextSegment++;
         }
-        else if (read_bytes == 0)
+
+        const size_t slot = segment % fetch.slots.size();
+        const uint32_t length = fetch.segmentLength(segment);
+        bool ok = false;
+        for (int attempt = 0; attempt < 2 && !ok; ++attempt)
+        {
+            if (!client)
+            {
+                client = createFirmwareClient(fetch.mirrors[mirror % fetch.mirrors.size()], kReadTimeoutMs);
+            }
+            ok = client && fetchRange(client, segment * kSegmentSize, length, fetch.slots[slot].data());
+            if (!ok)
+            {
+                if (client)
+                {
+                    closeRequest(client);
+                    client = nullptr;
+                }
+                ++mirror;
+            }
+        }
+
+        std::lock_guard<std::mutex> lock(fetch.mutex);
+        if (ok)
         {
-            break; // End of stream
+            fetch.ready[slot] = true;
         }
-        err = esp_ota_write(*otaHandleOut, tempBuffer, read_bytes);
+        else
+        {
+            ESP_LOGW(TAG_OTA_HTTP_DOWNLOADER, "Range worker %d gave up on segment %" PRIu32, index, segment);
+            fetch.failed = true;
+        }
+        fetch.cv.notify_all();
+        if (!ok)
+        {
+            break;
+        }
+    }
+
+    if (client)
+    {
+        closeRequest(client);
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(fetch.mutex);
+        --fetch.running;
+        fetch.cv.notify_all();
+    }
+    vTaskDelete(NULL);
+}
+
+HttpDownloader::TransferResult HttpDownloader::fetchParallel(const std::vector<std::string> &mirrors,
+                                                             esp_ota_handle_t otaHandle,
+                                                             uint32_t totalSize,
+                                                             uint32_t *writtenInOut,
+                                                             FirmwareDecryptor *decryptor)
+{
+    // Continues after the first request's segment, which is already written
+    ParallelFetch fetch(mirrors, totalSize, *writtenInOut / kSegmentSize, maxConnections + 1);
+    if (decryptor)
+    {
+        decryptor->seek(*writtenInOut);
+    }
+    if (!spawnRangeWorker(fetch, 0))
+    {
+        return TransferResult::Interrupted;
+    }
+
+    TransferResult result = TransferResult::Complete;
+    uint32_t loggedDecile = static_cast<uint64_t>(*writtenInOut) * 10 / totalSize;
+    int64_t windowStart = esp_timer_get_time();
+    uint32_t windowBytes = 0;
+    int64_t previousRate = 0;
+    bool ramping = true;
+    bool warmingUp = true; // The window after adding a connection includes its TLS handshake
+
+    while (fetch.writtenSegments < fetch.segmentCount)
+    {
+        const uint32_t segment = fetch.writtenSegments;
+        const size_t slot = segment % fetch.slots.size();
+        {
+            std::unique_lock<std::mutex> lock(fetch.mutex);
+            fetch.cv.wait(lock, [&]
+                          { return fetch.ready[slot] || fetch.failed || fetch.running == 0; });
+            if (!fetch.ready[slot])
+            {
+                result = TransferResult::Interrupted;
+                break;
+            }
+        }
+
+        uint8_t *data = fetch.slots[slot].data();
+        const uint32_t length = fetch.segmentLength(segment);
+        if (decryptor && !decryptor->decrypt(data, length))
+        {
+            result = TransferResult::Fatal;
+            break;
+        }
+
+        esp_err_t err = esp_ota_write(otaHandle, data, length);
         if (err != ESP_OK)
         {
-            ESP_LOGE(TAG_OTA_HTTP_DOWNLOADER, "esp_ota_write failed at offset %d: %s", total_written, esp_err_to_name(err));
-            esp_http_client_close(client);
-            esp_http_client_cleanup(client);
+            ESP_LOGE(TAG_OTA_HTTP_DOWNLOADER, "esp_ota_write failed at offset %" PRIu32 ": %s", *writtenInOut,
+                     esp_err_to_name(err));
+            result = TransferResult::Fatal;
+            break;
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(fetch.mutex);
+            fetch.ready[slot] = false;
+            ++fetch.writtenSegments;
+            fetch.cv.notify_all();
+        }
+        *writtenInOut += length;
+        windowBytes += length;
+        logProgress(*writtenInOut, totalSize, &loggedDecile);
+
+        if (fetch.writtenSegments % kRampWindowSegments != 0)
+        {
+            continue;
+        }
+
+        // Adapt the connection count once per window of segments
+        const int64_t now = esp_timer_get_time();
+        const int64_t rate = static_cast<int64_t>(windowBytes) * 1000000 / std::max<int64_t>(1, now - windowStart);
+        windowStart = now;
+        windowBytes = 0;
+        const int active = fetch.activeLimit;
+
+        if (active > 1 && esp_get_free_heap_size() < kHeapReserve)
+        {
+            std::lock_guard<std::mutex> lock(fetch.mutex);
+            fetch.activeLimit = active - 1;
+            fetch.cv.notify_all();
+            ramping = false;
+            ESP_LOGW(TAG_OTA_HTTP_DOWNLOADER, "Low heap, dropping to %d connection(s)", active - 1);
+        }
+        else if (warmingUp)
+        {
+            warmingUp = false;
+        }
+        else if (ramping && active > 1 && rate * 5 < previousRate * 6)
+        {
+            // The last connection added less than 20%: the link is bandwidth-bound, not latency-bound
+            ESP_LOGI(TAG_OTA_HTTP_DOWNLOADER, "Connection %d raised throughput only %" PRId64 " -> %" PRId64
+                     " KB/s", active, previousRate / 1024, rate / 1024);
+            if (active == 2)
+            {
+                result = TransferResult::Interrupted; // A single connection streams without per-range TTFB
+                break;
+            }
+            std::lock_guard<std::mutex> lock(fetch.mutex);
+            fetch.activeLimit = active - 1;
+            fetch.cv.notify_all();
+            ramping = false;
+        }
+        else if (ramping && active < maxConnections &&
+                 esp_get_free_heap_size() >= kHeapReserve + kConnectionHeapCost && spawnRangeWorker(fetch, active))
+        {
+            previousRate = rate;
+            warmingUp = true;
+            ESP_LOGI(TAG_OTA_HTTP_DOWNLOADER, "Range fetch at %" PRId64 " KB/s (%" PRId64
+                     " KB/s per connection), adding connection %d", rate / 1024, rate / 1024 / active, active + 1);
+        }
+        else if (ramping)
+        {
+            ramping = false;
+            ESP_LOGI(TAG_OTA_HTTP_DOWNLOADER, "Range fetch settled on %d connection(s) at %" PRId64 " KB/s",
+                     active, rate / 1024);
+        }
+    }
+
+    // Workers reference `fetch`; wait for all of them to exit before it goes out of scope
+    std::unique_lock<std::mutex> lock(fetch.mutex);
+    fetch.stop = true;
+    fetch.cv.notify_all();
+    fetch.cv.wait(lock, [&]
+                  { return fetch.running == 0; });
+    return result;
+}
+
+HttpDownloader::TransferResult HttpDownloader::fetchAdaptive(const std::vector<std::string> &mirrors,
+                                                             const esp_partition_t *partition,
+                                                             esp_ota_handle_t *otaHandleOut,
+                                                             std::vector<uint8_t> &buffer,
+                                                             uint32_t *totalSizeOut,
+                                                             uint32_t *writtenInOut,
+                                                             bool *otaStartedOut,
+                                                             FirmwareDecryptor *decryptor)
+{
+    // Open-ended, so a 206 shows the mirror honours Range and the same response can
+    // still carry the whole image if one stream turns out faster
+    int64_t contentLength = 0;
+    int status = 0;
+    const int64_t requestStart = esp_timer_get_time();
+    esp_http_client_handle_t client = openFirmwareRequest(mirrors.front(), "bytes=0-", kReadTimeoutMs, &contentLength,
+                                                          &status);
+    if (!client)
+    {
+        return TransferResult::Interrupted;
+    }
+    const int64_t ttfbUs = esp_timer_get_time() - requestStart;
+
+    *totalSizeOut = static_cast<uint32_t>(contentLength);
+    esp_err_t err = esp_ota_begin(partition, *totalSizeOut, otaHandleOut);
+    if (err != ESP_OK)
+    {
+        ESP_LOGE(TAG_OTA_HTTP_DOWNLOADER, "esp_ota_begin failed: %s", esp_err_to_name(err));
+        closeRequest(client);
+        return TransferResult::Fatal;
+    }
+    *otaStartedOut = true;
+    if (decryptor)
+    {
+        decryptor->seek(0);
+    }
+
+    // Smaller images, and servers that ignore Range (200), stay on this stream
+    bool useRanges = status == 206 && *totalSizeOut >= kMinParallelSize;
+    TransferResult result = TransferResult::Complete;
+    if (useRanges)
+    {
+        const int64_t bodyStart = esp_timer_get_time();
+        result = streamToPartition(client, *otaHandleOut, buffer, *totalSizeOut, kSegmentSize, writtenInOut, decryptor);
+        const int64_t rate = static_cast<int64_t>(kSegmentSize) * 1000000 /
+                             std::max<int64_t>(1, esp_timer_get_time() - bodyStart);
+
+        // One stream pays the TTFB once; N range connections beat it only while
+        // (N - 1) * kSegmentSize > TTFB * per-connection rate
+        useRanges = result == TransferResult::Complete &&
+                    static_cast<int64_t>(maxConnections - 1) * kSegmentSize * 1000000 > ttfbUs * rate;
+        ESP_LOGI(TAG_OTA_HTTP_DOWNLOADER, "TTFB %" PRId64 " ms at %" PRId64 " KB/s: %s", ttfbUs / 1000, rate / 1024,
+                 useRanges ? "fetching the rest as ranges" : "one stream is faster");
+    }
+    if (!useRanges && result == TransferResult::Complete)
+    {
+        result = streamToPartition(client, *otaHandleOut, buffer, *totalSizeOut, *totalSizeOut, writtenInOut,
+                                   decryptor);
+    }
+    closeRequest(client);
+    if (!useRanges || result != TransferResult::Complete)
+    {
+        return result;
+    }
+
+    ESP_LOGI(TAG_OTA_HTTP_DOWNLOADER, "Fetching %" PRIu32 " bytes in %" PRIu32 " byte ranges over up to %d connections",
+             *totalSizeOut - *writtenInOut, kSegmentSize, maxConnections);
+    return fetchParallel(mirrors, *otaHandleOut, *totalSizeOut, writtenInOut, decryptor);
+}
+
+bool HttpDownloader::downloadToPartition(const std::vector<std::string> &firmwareUrls,
+                                         const std::string &signatureUrl,
+                                         const esp_partition_t *partition,
+                                         esp_ota_handle_t *otaHandleOut,
+                                         uint32_t *firmwareSizeOut,
+                                         std::vector<uint8_t> &signatureOut,
+                                         FirmwareDecryptor *decryptor)
+{
+    if (firmwareUrls.empty())
+    {
+        ESP_LOGE(TAG_OTA_HTTP_DOWNLOADER, "No firmware URL");
+        return false;
+    }
+
+    // ---- Firmware Download ----
+    std::vector<std::string> mirrors = rankMirrors(firmwareUrls);
+    std::vector<uint8_t> tempBuffer(chunkSize);
+
+    bool otaStarted = false;
+    uint32_t totalSize = 0;
+    uint32_t written = 0;
+    bool complete = false;
+
+    // Parallel ranges need heap for the reorder buffer plus two connections
+    const size_t parallelHeap = (maxConnections + 1) * kSegmentSize + kHeapReserve + 2 * kConnectionHeapCost;
+    if (maxConnections > 1 && esp_get_free_heap_size() >= parallelHeap)
+    {
+        TransferResult result = fetchAdaptive(mirrors, partition, otaHandleOut, tempBuffer, &totalSize,
+                                              &written, &otaStarted, decryptor);
+        if (result == TransferResult::Fatal)
+        {
+            if (otaStarted)
+            {
+                esp_ota_abort(*otaHandleOut);
+            }
             return false;
         }
-        total_written += read_bytes;
-        ESP_LOGI(TAG_OTA_HTTP_DOWNLOADER, "Firmware chunk written: %d bytes, total: %d", read_bytes, total_written);
+        complete = (result == TransferResult::Complete);
+        if (!complete && otaStarted)
+        {
+            ESP_LOGI(TAG_OTA_HTTP_DOWNLOADER, "Fetch stopped at offset %" PRIu32 ", continuing on one connection",
+                     written);
+        }
     }
 
-    esp_http_client_close(client);
-    esp_http_client_cleanup(client);
+    // Each mirror gets two chances; a retry resumes from the current offset
+    const size_t maxAttempts = mirrors.size() * 2;
+    for (size_t attempt = 0; attempt < maxAttempts && !complete; ++attempt)
+    {
+        const std::string &url = mirrors[attempt % mirrors.size()];
+        char range[32] = {0};
+        if (written > 0)
+        {
+            snprintf(range, sizeof(range), "bytes=%" PRIu32 "-", written);
+        }
+        ESP_LOGI(TAG_OTA_HTTP_DOWNLOADER, "Downloading firmware from %s at offset %" PRIu32, url.c_str(), written);
+
+        int64_t content_length = 0;
+        int status_code = 0;
+        esp_http_client_handle_t client = openFirmwareRequest(url, written > 0 ? range : nullptr, kReadTimeoutMs,
+                                                              &content_length, &status_code);
+        if (!client)
+        {
+            continue;
+        }
+
+        if (!otaStarted)
+        {
+            totalSize = static_cast<uint32_t>(content_length);
+            ESP_LOGI(TAG_OTA_HTTP_DOWNLOADER, "Firmware HTTP response OK, size: %" PRIu32 " bytes", totalSize);
+
+            esp_err_t err = esp_ota_begin(partition, totalSize, otaHandleOut);
+            if (err != ESP_OK)
+            {
+                ESP_LOGE(TAG_OTA_HTTP_DOWNLOADER, "esp_ota_begin failed: %s", esp_err_to_name(err));
+                closeRequest(client);
+                return false;
+            }
+            otaStarted = true;
+        }
+        else if (written > 0 ? (status_code != 206 || content_length != static_cast<int64_t>(totalSize - written))
+                             : content_length != static_cast<int64_t>(totalSize))
+        {
+            ESP_LOGW(TAG_OTA_HTTP_DOWNLOADER, "Mirror cannot resume at offset %" PRIu32 " (status %d), skipping",
+                     written, status_code);
+            closeRequest(client);
+            continue;
+        }
+
+        if (decryptor)
+        {
+            decryptor->seek(written);
+        }
+        TransferResult result = streamToPartition(client, *otaHandleOut, tempBuffer, totalSize, totalSize, &written,
+                                                  decryptor);
+        closeRequest(client);
 
-    if (total_written != content_length)
+        if (result == TransferResult::Fatal)
+        {
+            esp_ota_abort(*otaHandleOut);
+            return false;
+        }
+        complete = (result == TransferResult::Complete);
+    }
+
+    if (!complete)
     {
-        ESP_LOGE(TAG_OTA_HTTP_DOWNLOADER, "Firmware size mismatch: expected %d, got %d", content_length, total_written);
+        ESP_LOGE(TAG_OTA_HTTP_DOWNLOADER, "Firmware download failed on all mirrors (%" PRIu32 "/%" PRIu32 " bytes)",
+                 written, totalSize);
+        if (otaStarted)
+        {
+            esp_ota_abort(*otaHandleOut);
+        }
         return false;
     }
 
-    *firmwareSizeOut = static_cast<uint32_t>(total_written);
+    *firmwareSizeOut = written;
     ESP_LOGI(TAG_OTA_HTTP_DOWNLOADER, "Firmware download complete, total bytes: %" PRIu32, *firmwareSizeOut);
 
     // ---- Signature Download ----
+    if (signatureUrl.empty())
+    {
+        return true; // Signature supplied inline by the caller
+    }
+
+    if (!downloadSignature(signatureUrl, tempBuffer, signatureOut))
+    {
+        esp_ota_abort(*otaHandleOut);
+        return false;
+    }
+    return true;
+}
+
+bool HttpDownloader::downloadSignature(const std::string &signatureUrl,
+                                       std::vector<uint8_t> &tempBuffer,
+                                       std::vector<uint8_t> &signatureOut)
+{
     ESP_LOGI(TAG_OTA_HTTP_DOWNLOADER, "Starting signature download from URL: %s", signatureUrl.c_str());
 
     esp_http_client_config_t sig_config = {};
     sig_config.url = signatureUrl.c_str();
-    sig_config.transport_type = HTTP_TRANSPORT_OVER_SSL;
-    sig_config.cert_pem = AWS_CA_CERT;
+    applyTlsConfig(sig_config);
     sig_config.disable_auto_redirect = true;
+    sig_config.timeout_ms = kReadTimeoutMs;
 
     esp_http_client_handle_t sigClient = esp_http_client_init(&sig_config);
     if (!sigClient)
@@ -146,8 +763,7 @@ bool HttpDownloader::downloadToPartition(const std::string &firmwareUrl,
     if (sig_length <= 0)
     {
         ESP_LOGE(TAG_OTA_HTTP_DOWNLOADER, "Invalid signature content length: %d", sig_length);
-        esp_http_client_close(sigClient);
-        esp_http_client_cleanup(sigClient);
+        closeRequest(sigClient);
         return false;
     }
 
@@ -159,13 +775,12 @@ bool HttpDownloader::downloadToPartition(const std::string &firmwareUrl,
     int read_total = 0;
     while (read_total < sig_length)
     {
-        int to_read = std::min<int>(sizeof(tempBuffer), sig_length - read_total);
-        int r = esp_http_client_read(sigClient, (char *)tempBuffer, to_read);
+        int to_read = std::min<int>(tempBuffer.size(), sig_length - read_total);
+        int r = esp_http_client_read(sigClient, (char *)tempBuffer.data(), to_read);
         if (r < 0)
         {
             ESP_LOGE(TAG_OTA_HTTP_DOWNLOADER, "HTTP read error during signature download");
-            esp_http_client_close(sigClient);
-            esp_http_client_cleanup(sigClient);
+            closeRequest(sigClient);
             return false;
         }
         else if (r == 0)
@@ -173,13 +788,12 @@ bool HttpDownloader::downloadToPartition(const std::string &firmwareUrl,
             break;
         }
 
-        memcpy(signatureOut.data() + read_total, tempBuffer, r);
+        memcpy(signatureOut.data() + read_total, tempBuffer.data(), r);
         read_total += r;
-        ESP_LOGI(TAG_OTA_HTTP_DOWNLOADER, "Signature chunk read: %d bytes, total: %d/%d", r, read_total, sig_length);
+        ESP_LOGD(TAG_OTA_HTTP_DOWNLOADER, "Signature chunk read: %d bytes, total: %d/%d", r, read_total, sig_length);
     }
 
-    esp_http_client_close(sigClient);
-    esp_http_client_cleanup(sigClient);
+    closeRequest(sigClient);
 
     if (read_total != sig_length)
     {
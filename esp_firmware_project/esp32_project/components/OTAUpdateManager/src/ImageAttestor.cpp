@@ -0,0 +1,158 @@
+#include "OTAUpdateManager/ImageAttestor.h"
+#include "esp_ota_ops.h"
+#include "esp_app_desc.h"
+#include "esp_image_format.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "mbedtls/sha256.h"
+#include <ArduinoJson.h>
+#include <cstring>
+#include <vector>
+#include <algorithm>
+#include <inttypes.h>
+
+#define NVS_KEY_ATTEST_CACHE "cache_key"
+#define NVS_KEY_ATTEST_DIGEST "digest"
+
+static std::string toHex(const uint8_t *data, size_t len)
+{
+    char hex[65] = {0};
+    for (size_t i = 0; i < len && i < 32; ++i)
+        sprintf(hex + (i * 2), "%02x", data[i]);
+    return std::string(hex);
+}
+
+ImageAttestor &ImageAttestor::instance()
+{
+    static ImageAttestor attestor;
+    return attestor;
+}
+
+ImageAttestor::ImageAttestor() : nvs("nvs", "attest") {}
+
+void ImageAttestor::start()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    if (started)
+    {
+        return;
+    }
+    started = true;
+
+    partition = esp_ota_get_running_partition();
+    if (!partition)
+    {
+        ESP_LOGE(TAG_IMAGE_ATTESTOR, "No running partition");
+        return;
+    }
+
+    // Image length comes from the segment headers only; nothing is hashed here
+    esp_partition_pos_t pos = {partition->address, partition->size};
+    esp_image_metadata_t metadata = {};
+    if (esp_image_get_metadata(&pos, &metadata) != ESP_OK)
+    {
+        ESP_LOGE(TAG_IMAGE_ATTESTOR, "Failed to read image metadata");
+        return;
+    }
+    imageLen = metadata.image_len;
+
+    const esp_app_desc_t *app = esp_app_get_description();
+    cacheKey = std::string(partition->label) + ":" + std::to_string(imageLen) + ":" + toHex(app->app_elf_sha256, 32);
+
+    std::vector<uint8_t> cachedKey, cachedDigest;
+    if (nvs.getBlob(NVS_KEY_ATTEST_CACHE, cachedKey) && nvs.getBlob(NVS_KEY_ATTEST_DIGEST, cachedDigest) &&
+        std::string(cachedKey.begin(), cachedKey.end()) == cacheKey && cachedDigest.size() == 32)
+    {
+        digestHex = toHex(cachedDigest.data(), cachedDigest.size());
+        ESP_LOGI(TAG_IMAGE_ATTESTOR, "Cached image digest: %s", digestHex.c_str());
+    }
+
+    xTaskCreate(&ImageAttestor::taskEntry, "image_attest", 4096, this, tskIDLE_PRIORITY + 1, NULL);
+}
+
+void ImageAttestor::taskEntry(void *arg)
+{
+    ImageAttestor *self = static_cast<ImageAttestor *>(arg);
+
+    int64_t startUs = esp_timer_get_time();
+    uint8_t digest[32];
+    if (self->computeDigest(digest))
+    {
+        std::string hex = toHex(digest, sizeof(digest));
+        ESP_LOGI(TAG_IMAGE_ATTESTOR, "Image digest computed in %" PRId64 " ms: %s",
+                 (esp_timer_get_time() - startUs) / 1000, hex.c_str());
+
+        std::lock_guard<std::mutex> lock(self->mutex);
+        if (hex != self->digestHex)
+        {
+            if (!self->digestHex.empty())
+            {
+                ESP_LOGW(TAG_IMAGE_ATTESTOR, "Cached digest was stale (%s)", self->digestHex.c_str());
+            }
+            self->digestHex = hex;
+            self->nvs.storeBlob(NVS_KEY_ATTEST_CACHE, std::vector<uint8_t>(self->cacheKey.begin(), self->cacheKey.end()));
+            self->nvs.storeBlob(NVS_KEY_ATTEST_DIGEST, std::vector<uint8_t>(digest, digest + sizeof(digest)));
+        }
+        self->verified = true;
+    }
+
+    vTaskDelete(NULL);
+}
+
+bool ImageAttestor::computeDigest(uint8_t out[32])
+{
+    mbedtls_sha256_context ctx;
+    mbedtls_sha256_init(&ctx);
+    mbedtls_sha256_starts(&ctx, 0);
+
+    for (uint32_t offset = 0; offset < imageLen; offset += kSpanSize)
+    {
+        uint32_t span = std::min<uint32_t>(kSpanSize, imageLen - offset);
+
+        // Zero-copy: hash straight out of the flash cache mapping
+        const void *mapped = nullptr;
+        esp_partition_mmap_handle_t handle;
+        esp_err_t err = esp_partition_mmap(partition, offset, span, ESP_PARTITION_MMAP_DATA, &mapped, &handle);
+        if (err != ESP_OK)
+        {
+            ESP_LOGE(TAG_IMAGE_ATTESTOR, "esp_partition_mmap failed at offset %" PRIu32 ": %s", offset, esp_err_to_name(err));
+            mbedtls_sha256_free(&ctx);
+            return false;
+        }
+
+        mbedtls_sha256_update(&ctx, static_cast<const uint8_t *>(mapped), span);
+        esp_partition_munmap(handle);
+
+        vTaskDelay(1); // Let everything else run between spans
+    }
+
+    mbedtls_sha256_finish(&ctx, out);
+    mbedtls_sha256_free(&ctx);
+    return true;
+}
+
+std::string ImageAttestor::buildReport(const std::string &nonce)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+
+    StaticJsonDocument<384> doc;
+    doc["partition"] = partition ? partition->label : "";
+    doc["image_len"] = imageLen;
+    doc["image_sha256"] = digestHex;
+    doc["state"] = verified ? "verified" : (digestHex.empty() ? "computing" : "cached");
+    if (!nonce.empty())
+    {
+        doc["nonce"] = nonce;
+    }
+
+    std::string out;
+    serializeJson(doc, out);
+    return out;
+}
+
+std::string ImageAttestor::imageDigest()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return digestHex;
+}
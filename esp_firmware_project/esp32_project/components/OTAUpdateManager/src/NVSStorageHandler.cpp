@@ -1,4 +1,6 @@
 #include "OTAUpdateManager/NVSStorageHandler.h"
+#include "esp_partition.h"
+#include "sdkconfig.h"
 
 #define NVS_KEY_VERSION "fm_ver"
 
@@ -17,6 +19,36 @@ bool NVSStorageHandler::begin()
     return true;
 }
 
+bool NVSStorageHandler::beginEncrypted()
+{
+#if CONFIG_NVS_ENCRYPTION
+    // The XTS keys are provisioned with the partition; never generate them here
+    const esp_partition_t *keys = esp_partition_find_first(ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_DATA_NVS_KEYS, NULL);
+    if (!keys)
+    {
+        ESP_LOGE(TAG_OTA_NVS_STORAGE, "No nvs_keys partition for '%s'", partition.c_str());
+        return false;
+    }
+
+    nvs_sec_cfg_t cfg;
+    esp_err_t err = nvs_flash_read_security_cfg(keys, &cfg);
+    if (err == ESP_OK)
+    {
+        err = nvs_flash_secure_init_partition(partition.c_str(), &cfg);
+    }
+    if (err != ESP_OK)
+    {
+        ESP_LOGE(TAG_OTA_NVS_STORAGE, "Failed to init encrypted NVS partition '%s': %s", partition.c_str(), esp_err_to_name(err));
+        return false;
+    }
+    ESP_LOGI(TAG_OTA_NVS_STORAGE, "Initialized encrypted NVS partition '%s'", partition.c_str());
+    return true;
+#else
+    ESP_LOGE(TAG_OTA_NVS_STORAGE, "Encrypted NVS partition '%s' needs CONFIG_NVS_ENCRYPTION", partition.c_str());
+    return false;
+#endif
+}
+
 std::string NVSStorageHandler::getFirmwareVersion(const std::string &defaultVersion)
 {
     nvs_handle_t handle;
@@ -88,3 +120,78 @@ bool NVSStorageHandler::storeFirmwareVersion(const std::string &version)
     ESP_LOGI(TAG_OTA_NVS_STORAGE, "Firmware version stored successfully: %s", version.c_str());
     return true;
 }
+
+bool NVSStorageHandler::getBlob(const std::string &key, std::vector<uint8_t> &out)
+{
+    nvs_handle_t handle;
+    esp_err_t err = nvs_open_from_partition(partition.c_str(), ns.c_str(), NVS_READONLY, &handle);
+    if (err != ESP_OK)
+    {
+        return false;
+    }
+
+    size_t length = 0;
+    err = nvs_get_blob(handle, key.c_str(), nullptr, &length);
+    if (err == ESP_OK)
+    {
+        out.resize(length);
+        err = nvs_get_blob(handle, key.c_str(), out.data(), &length);
+    }
+    nvs_close(handle);
+
+    if (err != ESP_OK && err != ESP_ERR_NVS_NOT_FOUND)
+    {
+        ESP_LOGE(TAG_OTA_NVS_STORAGE, "Error reading '%s': %s", key.c_str(), esp_err_to_name(err));
+    }
+    return err == ESP_OK;
+}
+
+bool NVSStorageHandler::storeBlob(const std::string &key, const std::vector<uint8_t> &data)
+{
+    nvs_handle_t handle;
+    esp_err_t err = nvs_open_from_partition(partition.c_str(), ns.c_str(), NVS_READWRITE, &handle);
+    if (err != ESP_OK)
+    {
+        ESP_LOGE(TAG_OTA_NVS_STORAGE, "Failed to open NVS for writing: %s", esp_err_to_name(err));
+        return false;
+    }
+
+    err = nvs_set_blob(handle, key.c_str(), data.data(), data.size());
+    if (err == ESP_OK)
+    {
+        err = nvs_commit(handle);
+    }
+    nvs_close(handle);
+
+    if (err != ESP_OK)
+    {
+        ESP_LOGE(TAG_OTA_NVS_STORAGE, "Failed to store '%s': %s", key.c_str(), esp_err_to_name(err));
+        return false;
+    }
+    return true;
+}
+
+bool NVSStorageHandler::eraseKey(const std::string &key)
+{
+    nvs_handle_t handle;
+    esp_err_t err = nvs_open_from_partition(partition.c_str(), ns.c_str(), NVS_READWRITE, &handle);
+    if (err != ESP_OK)
+    {
+        ESP_LOGE(TAG_OTA_NVS_STORAGE, "Failed to open NVS for writing: %s", esp_err_to_name(err));
+        return false;
+    }
+
+    err = nvs_erase_key(handle, key.c_str());
+    if (err == ESP_OK)
+    {
+        err = nvs_commit(handle);
+    }
+    nvs_close(handle);
+
+    if (err != ESP_OK && err != ESP_ERR_NVS_NOT_FOUND)
+    {
+        ESP_LOGE(TAG_OTA_NVS_STORAGE, "Failed to erase '%s': %s", key.c_str(), esp_err_to_name(err));
+        return false;
+    }
+    return true;
+}
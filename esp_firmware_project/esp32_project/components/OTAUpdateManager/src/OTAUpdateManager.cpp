@@ -1,15 +1,231 @@
 #include "OTAUpdateManager/OTAUpdateManager.h"
+#include "OTAUpdateManager/PerformanceProfile.h"
+#include "OTAUpdateManager/ImageAttestor.h"
 #include "esp_log.h"
 #include <ArduinoJson.h>
 #include <sys/stat.h>
 #include <string.h>
-#include <sstream>
 #include <vector>
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
 #include "esp_system.h"
 #include "esp_ota_ops.h"
+#include "esp_timer.h"
+#include "mbedtls/base64.h"
 #include <inttypes.h>
+#include <atomic>
+#include <algorithm>
+#include <cctype>
+#include <cerrno>
+#include <cstdlib>
+
+// Build with -DOTA_PERF_PROFILE=0 to compare update throughput without the profile
+#ifndef OTA_PERF_PROFILE
+#define OTA_PERF_PROFILE 1
+#endif
+
+// Upper bound on parallel range connections per download. One by default: ranges only pay off
+// on latency-bound links, so builds for those opt in (e.g. -DOTA_MAX_CONNECTIONS=3)
+#ifndef OTA_MAX_CONNECTIONS
+#define OTA_MAX_CONNECTIONS 1
+#endif
+
+static std::atomic<bool> s_updateInProgress{false};
+
+static bool decodeBase64(const char *b64, std::vector<uint8_t> &out)
+{
+    size_t b64Len = strlen(b64);
+    size_t outLen = 0;
+    out.resize(b64Len * 3 / 4);
+    if (mbedtls_base64_decode(out.data(), out.size(), &outLen, reinterpret_cast<const uint8_t *>(b64), b64Len) != 0)
+    {
+        out.clear();
+        return false;
+    }
+    out.resize(outLen);
+    return true;
+}
+
+static void logThroughput(const char *stage, uint32_t bytes, int64_t elapsedUs)
+{
+    int64_t ms = elapsedUs / 1000;
+    int64_t kbPerSec = elapsedUs > 0 ? static_cast<int64_t>(bytes) * 1000000 / elapsedUs / 1024 : 0;
+    ESP_LOGI(TAG_OTA_UPDATE, "%s: %" PRIu32 " bytes in %" PRId64 " ms (%" PRId64 " KB/s) at %" PRIu32 " MHz",
+             stage, bytes, ms, kbPerSec, PerformanceProfile::cpuFreqMhz());
+}
+
+// "HH:MM-HH:MM" in UTC, e.g. "02:00-04:00"
+static bool parseWindow(const char *window, ActivationPolicy &policy)
+{
+    unsigned startH, startM, endH, endM;
+    if (sscanf(window, "%2u:%2u-%2u:%2u", &startH, &startM, &endH, &endM) != 4 ||
+        startH > 23 || endH > 23 || startM > 59 || endM > 59)
+    {
+        return false;
+    }
+    policy.windowStartMin = startH * 60 + startM;
+    policy.windowEndMin = endH * 60 + endM;
+    return policy.windowStartMin != policy.windowEndMin;
+}
+
+static bool parseActivationPolicy(const char *name, const char *window, ActivationPolicy &policy)
+{
+    if (strcmp(name, "immediate") == 0)
+        policy.type = ActivationPolicy::Type::Immediate;
+    else if (strcmp(name, "command") == 0)
+        policy.type = ActivationPolicy::Type::Command;
+    else if (strcmp(name, "next_boot") == 0)
+        policy.type = ActivationPolicy::Type::NextBoot;
+    else if (strcmp(name, "window") == 0)
+    {
+        policy.type = ActivationPolicy::Type::Window;
+        return parseWindow(window, policy);
+    }
+    else
+        return false;
+    return true;
+}
+
+// Version of the running image, read from NVS once per boot.
+static const std::string &cachedCurrentVersion()
+{
+    static const std::string version = []
+    {
+        NVSStorageHandler nvs("nvs", "firmware");
+        nvs.begin();
+        return nvs.getFirmwareVersion("1.0.0");
+    }();
+    return version;
+}
+
+bool ota_start_update_task(const char *data, int len)
+{
+    if (!data || len <= 0)
+    {
+        return false;
+    }
+
+    StaticJsonDocument<96> filter;
+    filter["version"] = true;
+    filter["rollback"] = true;
+    filter["encryption"]["alg"] = true;
+
+    StaticJsonDocument<192> doc;
+    DeserializationError error = deserializeJson(doc, data, len, DeserializationOption::Filter(filter));
+    if (error || !doc["version"].is<const char *>())
+    {
+        ESP_LOGE(TAG_OTA_UPDATE, "Update command has no version");
+        return false;
+    }
+
+    const std::string version = doc["version"].as<std::string>();
+    if (!OtaUpdateManager::shouldInstall(version, cachedCurrentVersion(), doc["rollback"] | false))
+    {
+        ESP_LOGI(TAG_OTA_UPDATE, "Already up to date (%s), ignoring command", cachedCurrentVersion().c_str());
+        return false;
+    }
+
+    // Without a KEK store the release key cannot be unwrapped; fail before downloading anything
+    if (!doc["encryption"].isNull() && !FirmwareDecryptor::keyStoreAvailable())
+    {
+        ESP_LOGE(TAG_OTA_UPDATE, "Firmware %s is encrypted but this build has no key store, ignoring command",
+                 version.c_str());
+        return false;
+    }
+
+    // Installing it again would fail the same way; a fixed build needs a new version
+    if (BootHealthCheck::instance().rolledBack(version))
+    {
+        ESP_LOGW(TAG_OTA_UPDATE, "Firmware %s was rolled back on this device, ignoring command", version.c_str());
+        return false;
+    }
+
+    // esp_ota_begin refuses to overwrite the fallback image while this one is on trial
+    if (BootHealthCheck::instance().pending())
+    {
+        ESP_LOGI(TAG_OTA_UPDATE, "Health check pending, ignoring command for %s", version.c_str());
+        return false;
+    }
+
+    ActivationManager &activation = ActivationManager::instance();
+    if (activation.restartScheduled())
+    {
+        ESP_LOGI(TAG_OTA_UPDATE, "Activation restart pending, ignoring command for %s", version.c_str());
+        return false;
+    }
+    if (activation.pendingVersion() == version)
+    {
+        ESP_LOGI(TAG_OTA_UPDATE, "Firmware %s already staged, ignoring command", version.c_str());
+        return false;
+    }
+
+    bool expected = false;
+    if (!s_updateInProgress.compare_exchange_strong(expected, true))
+    {
+        ESP_LOGW(TAG_OTA_UPDATE, "Update already in progress, ignoring command for %s", version.c_str());
+        return false;
+    }
+
+    auto *params = new ota_task_params_t{std::string(data, len)};
+    if (xTaskCreate(&ota_update_task, "ota_update_task", 8192, params, 5, NULL) != pdPASS)
+    {
+        ESP_LOGE(TAG_OTA_UPDATE, "Failed to create OTA update task");
+        delete params;
+        s_updateInProgress = false;
+        return false;
+    }
+    return true;
+}
+
+bool ota_handle_activate_command(const char *data, int len)
+{
+    StaticJsonDocument<128> doc;
+    if (!data || len <= 0 || deserializeJson(doc, data, len) || !doc["version"].is<const char *>())
+    {
+        ESP_LOGE(TAG_OTA_UPDATE, "Activate command has no version");
+        return false;
+    }
+    return ActivationManager::instance().activate(doc["version"].as<std::string>());
+}
+
+std::string ota_build_status_report()
+{
+    StaticJsonDocument<512> doc;
+    doc["version"] = cachedCurrentVersion();
+
+    // Same digest as the command's `checksum`; left out until ImageAttestor has one
+    std::string checksum = ImageAttestor::instance().imageDigest();
+    if (!checksum.empty())
+    {
+        doc["checksum"] = checksum;
+    }
+
+    // Whether encrypted releases can be installed; see FirmwareDecryptor::keyStoreAvailable()
+    doc["encryption"] = FirmwareDecryptor::keyStoreAvailable();
+
+    std::string staged = ActivationManager::instance().pendingVersion();
+    if (!staged.empty())
+    {
+        doc["staged"] = staged;
+    }
+
+    // Versions listed here roll back or forward without a download
+    SlotImage inactive;
+    if (SlotIndex().lookup(esp_ota_get_next_update_partition(NULL), inactive))
+    {
+        doc["inactive_slot"] = inactive.version;
+    }
+
+    std::string health = BootHealthCheck::instance().lastOutcomeJson();
+    if (!health.empty())
+    {
+        doc["health"] = serialized(health);
+    }
+
+    std::string out;
+    serializeJson(doc, out);
+    return out;
+}
 
 void ota_update_task(void *param)
 {
@@ -21,19 +237,13 @@ void ota_update_task(void *param)
 
     delete taskParams;
 
+    // Staged images restart per their activation policy, see ActivationManager
     if (update_successful)
     {
         ESP_LOGI(TAG_OTA_UPDATE, "OTA update successful.");
-
-        ESP_LOGI(TAG_OTA_UPDATE, " Restarting device... 3");
-        vTaskDelay(pdMS_TO_TICKS(1000));
-        ESP_LOGI(TAG_OTA_UPDATE, " Restarting device... 2");
-        vTaskDelay(pdMS_TO_TICKS(1000));
-        ESP_LOGI(TAG_OTA_UPDATE, " Restarting device... 1");
-        vTaskDelay(pdMS_TO_TICKS(1000));
-        esp_restart();
     }
 
+    s_updateInProgress = false;
     vTaskDelete(NULL);
 }
 
@@ -63,7 +273,7 @@ bool OtaUpdateManager::handleUpdateRequest(const std::string &payload)
 
     ESP_LOGI(TAG_OTA_UPDATE, "Parsed firmware metadata. Version: %s", metadata.version.c_str());
 
-    if (!isNewVersion(metadata.version))
+    if (!shouldInstall(metadata.version, currentVersion, metadata.rollback))
     {
         ESP_LOGI(TAG_OTA_UPDATE, "No new firmware update available.");
         return false;
@@ -71,7 +281,7 @@ bool OtaUpdateManager::handleUpdateRequest(const std::string &payload)
 
     if (performUpdate(metadata))
     {
-        ESP_LOGI(TAG_OTA_UPDATE, "Firmware updated successfully to version: %s", metadata.version.c_str());
+        ESP_LOGI(TAG_OTA_UPDATE, "Firmware %s downloaded, verified and staged", metadata.version.c_str());
         return true;
     }
     else
@@ -83,7 +293,7 @@ bool OtaUpdateManager::handleUpdateRequest(const std::string &payload)
 
 bool OtaUpdateManager::parsePayload(const std::string &jsonStr, FirmwareMetadata &outMeta)
 {
-    DynamicJsonDocument doc(1024);
+    DynamicJsonDocument doc(3072); // Room for mirrors, inline signature and encryption block
     DeserializationError error = deserializeJson(doc, jsonStr);
 
     if (error)
@@ -93,7 +303,8 @@ bool OtaUpdateManager::parsePayload(const std::string &jsonStr, FirmwareMetadata
     }
 
     if (!doc["version"].is<const char *>() || !doc["firmware_url"].is<const char *>() ||
-        !doc["signature_url"].is<const char *>() || !doc["checksum"].is<const char *>())
+        !(doc["signature_url"].is<const char *>() || doc["signature"].is<const char *>()) ||
+        !doc["checksum"].is<const char *>())
     {
         ESP_LOGE(TAG_OTA_UPDATE, "JSON missing required keys");
         return false;
@@ -101,33 +312,109 @@ bool OtaUpdateManager::parsePayload(const std::string &jsonStr, FirmwareMetadata
 
     outMeta.version = doc["version"].as<std::string>();
     outMeta.firmwareUrl = doc["firmware_url"].as<std::string>();
-    outMeta.signatureUrl = doc["signature_url"].as<std::string>();
+
+    // Optional ranked mirrors; firmware_url always leads so older publishers keep working
+    outMeta.firmwareUrls.assign(1, outMeta.firmwareUrl);
+    for (JsonVariant mirror : doc["firmware_urls"].as<JsonArray>())
+    {
+        if (mirror.is<const char *>() && mirror.as<std::string>() != outMeta.firmwareUrl)
+        {
+            outMeta.firmwareUrls.push_back(mirror.as<std::string>());
+        }
+    }
+    outMeta.signatureUrl = doc["signature_url"].is<const char *>() ? doc["signature_url"].as<std::string>() : "";
     outMeta.expectedChecksum = doc["checksum"].as<std::string>();
 
+    outMeta.signature.clear();
+    if (doc["signature"].is<const char *>() && !decodeBase64(doc["signature"].as<const char *>(), outMeta.signature))
+    {
+        ESP_LOGE(TAG_OTA_UPDATE, "Invalid base64 signature");
+        return false;
+    }
+
+    outMeta.wrappedKey.clear();
+    outMeta.encryptionIv.clear();
+    JsonVariant encryption = doc["encryption"];
+    if (!encryption.isNull())
+    {
+        const char *alg = encryption["alg"] | "";
+        if (strcmp(alg, "aes-256-ctr") != 0 ||
+            !decodeBase64(encryption["wrapped_key"] | "", outMeta.wrappedKey) ||
+            !decodeBase64(encryption["iv"] | "", outMeta.encryptionIv) ||
+            outMeta.wrappedKey.empty() || outMeta.encryptionIv.size() != 16)
+        {
+            ESP_LOGE(TAG_OTA_UPDATE, "Unsupported or malformed encryption block (alg '%s')", alg);
+            return false;
+        }
+    }
+
+    outMeta.activation = ActivationPolicy();
+    JsonVariant activation = doc["activation"];
+    if (!activation.isNull() &&
+        !parseActivationPolicy(activation["policy"] | "", activation["window"] | "", outMeta.activation))
+    {
+        ESP_LOGE(TAG_OTA_UPDATE, "Invalid activation policy '%s'", activation["policy"] | "");
+        return false;
+    }
+    outMeta.rollback = doc["rollback"] | false;
+
     return true;
 }
 
 bool OtaUpdateManager::isNewVersion(const std::string &newVersion)
 {
-    auto parseVersion = [](const std::string &ver) -> std::vector<int>
+    return isNewerVersion(newVersion, currentVersion);
+}
+
+// Parses "major[.minor[.patch]]"; missing parts are 0. Built without exceptions, so no std::stoi.
+static bool parseVersion(const std::string &ver, unsigned long (&parts)[3])
+{
+    const char *p = ver.c_str();
+    for (size_t i = 0; i < 3; ++i)
     {
-        std::vector<int> parts;
-        std::stringstream ss(ver);
-        std::string item;
-        while (std::getline(ss, item, '.'))
+        parts[i] = 0;
+    }
+    for (size_t i = 0; i < 3; ++i)
+    {
+        // strtoul would also accept leading whitespace and a sign
+        if (!isdigit(static_cast<unsigned char>(*p)))
+        {
+            return false;
+        }
+        char *end = nullptr;
+        errno = 0;
+        parts[i] = strtoul(p, &end, 10);
+        if (errno == ERANGE)
         {
-            parts.push_back(std::stoi(item));
+            return false;
         }
-        return parts;
-    };
-
-    std::vector<int> currentParts = parseVersion(currentVersion);
-    std::vector<int> newParts = parseVersion(newVersion);
+        if (*end == '\0')
+        {
+            return true;
+        }
+        if (*end != '.')
+        {
+            return false;
+        }
+        p = end + 1;
+    }
+    return false; // More than three parts
+}
 
-    while (currentParts.size() < 3)
-        currentParts.push_back(0);
-    while (newParts.size() < 3)
-        newParts.push_back(0);
+bool OtaUpdateManager::isNewerVersion(const std::string &candidate, const std::string &current)
+{
+    unsigned long currentParts[3];
+    unsigned long newParts[3];
+    if (!parseVersion(candidate, newParts))
+    {
+        ESP_LOGE(TAG_OTA_UPDATE, "Malformed version \"%s\"", candidate.c_str());
+        return false;
+    }
+    if (!parseVersion(current, currentParts))
+    {
+        ESP_LOGE(TAG_OTA_UPDATE, "Malformed current version \"%s\"", current.c_str());
+        return false;
+    }
 
     for (size_t i = 0; i < 3; ++i)
     {
@@ -143,11 +430,27 @@ bool OtaUpdateManager::isNewVersion(const std::string &newVersion)
     return false;
 }
 
+bool OtaUpdateManager::shouldInstall(const std::string &candidate, const std::string &current, bool rollback)
+{
+    if (isNewerVersion(candidate, current))
+    {
+        return true;
+    }
+    // Without the flag, retained broadcast or cohort commands for an older release
+    // would flip a device between its two slots
+    unsigned long parts[3];
+    return rollback && candidate != current && parseVersion(candidate, parts);
+}
+
 bool OtaUpdateManager::performUpdate(const FirmwareMetadata &meta)
 {
     ESP_LOGI(TAG_OTA_UPDATE, "Starting firmware update...");
 
-    HttpDownloader downloader;
+#if OTA_PERF_PROFILE
+    PerformanceProfile profile; // Restored on every return below
+#endif
+
+    HttpDownloader downloader(1024, OTA_MAX_CONNECTIONS);
     SignatureVerifier verifier;
 
     const esp_partition_t *next_partition = esp_ota_get_next_update_partition(NULL);
@@ -157,16 +460,61 @@ bool OtaUpdateManager::performUpdate(const FirmwareMetadata &meta)
         return false;
     }
 
+    std::string checksum = meta.expectedChecksum;
+    std::transform(checksum.begin(), checksum.end(), checksum.begin(), [](unsigned char c)
+                   { return std::tolower(c); });
+
+    // The inactive slot may still hold this image: re-verify it in place instead of downloading
+    SlotIndex slots;
+    SlotImage indexed;
+    if (slots.lookup(next_partition, indexed) && indexed.version == meta.version)
+    {
+        int64_t verifyStart = esp_timer_get_time();
+        if (indexed.checksum != checksum)
+        {
+            ESP_LOGW(TAG_OTA_UPDATE, "Firmware %s in %s differs from the command's checksum, downloading",
+                     meta.version.c_str(), next_partition->label);
+        }
+        else if (verifier.verify(next_partition, indexed.imageSize, indexed.signature, indexed.checksum))
+        {
+            logThroughput("Re-verify", indexed.imageSize, esp_timer_get_time() - verifyStart);
+            ESP_LOGI(TAG_OTA_UPDATE, "Firmware %s already in %s, switching without download", meta.version.c_str(),
+                     next_partition->label);
+            return ActivationManager::instance().stage(next_partition, meta.version, meta.activation);
+        }
+        else
+        {
+            ESP_LOGW(TAG_OTA_UPDATE, "Firmware %s in %s failed re-verification, downloading", meta.version.c_str(),
+                     next_partition->label);
+        }
+    }
+
+    // Pre-encrypted image: unwrap the release key before touching the partition
+    FirmwareDecryptor decryptor;
+    const bool encrypted = !meta.wrappedKey.empty();
+    if (encrypted && !decryptor.begin(meta.wrappedKey, meta.encryptionIv))
+    {
+        ESP_LOGE(TAG_OTA_UPDATE, "Cannot decrypt firmware image");
+        return false;
+    }
+
+    // A previously staged or indexed image in this slot is about to be overwritten
+    ActivationManager::instance().discard(next_partition);
+    slots.forget(next_partition);
+
     esp_ota_handle_t ota_handle = 0;
     uint32_t firmwareSize = 0;
-    std::vector<uint8_t> signature;
+    std::vector<uint8_t> signature = meta.signature;
 
-    if (!downloader.downloadToPartition(meta.firmwareUrl,
-                                        meta.signatureUrl,
+    // An inline signature makes the separate signature download unnecessary
+    int64_t stageStart = esp_timer_get_time();
+    if (!downloader.downloadToPartition(meta.firmwareUrls,
+                                        signature.empty() ? meta.signatureUrl : std::string(),
                                         next_partition,
                                         &ota_handle,
                                         &firmwareSize,
-                                        signature))
+                                        signature,
+                                        encrypted ? &decryptor : nullptr))
     {
         ESP_LOGE(TAG_OTA_UPDATE, "Download to partition failed");
         return false;
@@ -174,6 +522,7 @@ bool OtaUpdateManager::performUpdate(const FirmwareMetadata &meta)
 
     ESP_LOGI(TAG_OTA_UPDATE, "Download complete: firmware size=%" PRIu32 ", signature size=%zu",
              firmwareSize, signature.size());
+    logThroughput(encrypted ? "Download+decrypt" : "Download", firmwareSize, esp_timer_get_time() - stageStart);
 
     if (esp_ota_end(ota_handle) != ESP_OK)
     {
@@ -181,22 +530,18 @@ bool OtaUpdateManager::performUpdate(const FirmwareMetadata &meta)
         return false;
     }
 
+    stageStart = esp_timer_get_time();
     if (!verifier.verify(next_partition, firmwareSize, signature, meta.expectedChecksum))
     {
         ESP_LOGE(TAG_OTA_UPDATE, "Firmware verification failed");
         return false;
     }
+    logThroughput("Verify", firmwareSize, esp_timer_get_time() - stageStart);
     ESP_LOGI(TAG_OTA_UPDATE, "Firmware verified successfully");
 
-    if (esp_ota_set_boot_partition(next_partition) != ESP_OK)
-    {
-        ESP_LOGE(TAG_OTA_UPDATE, "Failed to set boot partition");
-        return false;
-    }
-    ESP_LOGI(TAG_OTA_UPDATE, "Boot partition set to new OTA image");
+    // Not fatal: without an entry, a later rollback to this image downloads it again
+    slots.record(next_partition, {meta.version, firmwareSize, checksum, signature});
 
-    nvsStorageHandler.storeFirmwareVersion(meta.version);
-    ESP_LOGI(TAG_OTA_UPDATE, "Stored new firmware version: %s", meta.version.c_str());
-
-    return true;
+    // The version is committed to NVS on the first boot that runs the image
+    return ActivationManager::instance().stage(next_partition, meta.version, meta.activation);
 }
@@ -0,0 +1,87 @@
+#include "OTAUpdateManager/PerformanceProfile.h"
+#include "esp_wifi.h"
+#include "esp_rom_sys.h"
+#include "sdkconfig.h"
+#include <inttypes.h>
+
+uint32_t PerformanceProfile::cpuFreqMhz()
+{
+    return esp_rom_get_cpu_ticks_per_us();
+}
+
+// Lets a CPU_FREQ_MAX lock raise the clock to kMaxCpuFreqMhz. The minimum stays at
+// the configured default, so the clock outside an update is unchanged.
+esp_err_t PerformanceProfile::configureFrequencyScaling()
+{
+    static esp_err_t result = []
+    {
+        esp_pm_config_t config = {};
+        esp_err_t err = esp_pm_get_configuration(&config);
+        if (err != ESP_OK)
+        {
+            return err;
+        }
+        if (config.max_freq_mhz >= kMaxCpuFreqMhz)
+        {
+            return ESP_OK;
+        }
+        config.max_freq_mhz = kMaxCpuFreqMhz;
+        if (config.min_freq_mhz == 0)
+        {
+            config.min_freq_mhz = CONFIG_ESP_DEFAULT_CPU_FREQ_MHZ;
+        }
+        return esp_pm_configure(&config);
+    }();
+    return result;
+}
+
+PerformanceProfile::PerformanceProfile()
+{
+    uint32_t mhzBefore = cpuFreqMhz();
+
+    esp_err_t err = configureFrequencyScaling();
+    if (err == ESP_OK)
+    {
+        err = esp_pm_lock_create(ESP_PM_CPU_FREQ_MAX, 0, "ota_update", &cpuLock);
+    }
+    if (err == ESP_OK)
+    {
+        err = esp_pm_lock_acquire(cpuLock);
+        if (err != ESP_OK)
+        {
+            esp_pm_lock_delete(cpuLock);
+            cpuLock = nullptr;
+        }
+    }
+    if (err == ESP_ERR_NOT_SUPPORTED)
+    {
+        ESP_LOGW(TAG_OTA_PERF_PROFILE, "Power management disabled (CONFIG_PM_ENABLE), CPU stays at %" PRIu32 " MHz", mhzBefore);
+    }
+    else if (err != ESP_OK)
+    {
+        ESP_LOGW(TAG_OTA_PERF_PROFILE, "CPU frequency lock unavailable: %s", esp_err_to_name(err));
+    }
+
+    if (esp_wifi_get_ps(&previousPowerSave) == ESP_OK && previousPowerSave != WIFI_PS_NONE)
+    {
+        powerSaveChanged = esp_wifi_set_ps(WIFI_PS_NONE) == ESP_OK;
+    }
+
+    ESP_LOGI(TAG_OTA_PERF_PROFILE, "Profile on: CPU %" PRIu32 " -> %" PRIu32 " MHz, Wi-Fi power save %s",
+             mhzBefore, cpuFreqMhz(), powerSaveChanged ? "off" : "unchanged");
+}
+
+PerformanceProfile::~PerformanceProfile()
+{
+    if (cpuLock)
+    {
+        esp_pm_lock_release(cpuLock);
+        esp_pm_lock_delete(cpuLock);
+    }
+    if (powerSaveChanged)
+    {
+        esp_wifi_set_ps(previousPowerSave);
+    }
+
+    ESP_LOGI(TAG_OTA_PERF_PROFILE, "Profile off: CPU %" PRIu32 " MHz", cpuFreqMhz());
+}
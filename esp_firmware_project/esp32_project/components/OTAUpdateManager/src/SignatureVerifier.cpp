@@ -1,5 +1,5 @@
 #include "OTAUpdateManager/SignatureVerifier.h"
-#include "Common/certificates.h"
+#include "Common/CredentialStore.h"
 
 #include <cstdio>
 #include <cstring>
@@ -71,7 +71,7 @@ bool SignatureVerifier::verify(const esp_partition_t *partition,
 
     while (totalRead < firmwareSize)
     {
-        size_t toRead = std::min((uint32_t)chunkSize, firmwareSize - totalRead);
+        size_t toRead = std::min<size_t>(chunkSize, firmwareSize - totalRead);
         if (esp_partition_read(partition, totalRead, buffer, toRead) != ESP_OK)
         {
             ESP_LOGE(TAG_SIGNATURE_VERIFIER, "Failed to read from flash at offset %d", (int)totalRead);
@@ -102,25 +102,16 @@ bool SignatureVerifier::verify(const esp_partition_t *partition,
     ESP_LOGI(TAG_SIGNATURE_VERIFIER, "Checksum matched successfully.");
 
     // --- Signature Verification ---
-    mbedtls_pk_context pk;
-    mbedtls_pk_init(&pk);
-
-    int ret = mbedtls_pk_parse_public_key(
-        &pk,
-        reinterpret_cast<const uint8_t *>(FIRMWARE_SIGN_KEY),
-        strlen(FIRMWARE_SIGN_KEY) + 1);
-    if (ret != 0)
+    std::shared_ptr<mbedtls_pk_context> pk = CredentialStore::instance().firmwareSignKey();
+    if (!pk)
     {
-        ESP_LOGE(TAG_SIGNATURE_VERIFIER, "Failed to parse public key. mbedtls_pk_parse_public_key returned %d", ret);
-        mbedtls_pk_free(&pk);
+        ESP_LOGE(TAG_SIGNATURE_VERIFIER, "Firmware signing key unavailable");
         return false;
     }
 
-    ret = mbedtls_pk_verify(&pk, MBEDTLS_MD_SHA256,
-                            hash, sizeof(hash),
-                            signature.data(), signature.size());
-
-    mbedtls_pk_free(&pk);
+    int ret = mbedtls_pk_verify(pk.get(), MBEDTLS_MD_SHA256,
+                                hash, sizeof(hash),
+                                signature.data(), signature.size());
 
     if (ret != 0)
     {
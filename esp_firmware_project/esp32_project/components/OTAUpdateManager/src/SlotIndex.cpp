@@ -0,0 +1,82 @@
+#include "OTAUpdateManager/SlotIndex.h"
+#include <cstdio>
+#include <cstring>
+#include <inttypes.h>
+
+SlotIndex::SlotIndex() : nvs("nvs", "firmware") {}
+
+// Keyed by flash address: partition labels may exceed the 15-character NVS key limit
+std::string SlotIndex::keyFor(const esp_partition_t *partition)
+{
+    char key[16];
+    snprintf(key, sizeof(key), "slot_%08x", static_cast<unsigned>(partition->address));
+    return key;
+}
+
+bool SlotIndex::lookup(const esp_partition_t *partition, SlotImage &out)
+{
+    std::vector<uint8_t> blob;
+    if (!partition || !nvs.getBlob(keyFor(partition), blob) || blob.size() < sizeof(RecordHeader))
+    {
+        return false;
+    }
+
+    RecordHeader header;
+    memcpy(&header, blob.data(), sizeof(header));
+    if (blob.size() != sizeof(header) + header.signatureLen || header.imageSize == 0 ||
+        header.imageSize > partition->size)
+    {
+        ESP_LOGW(TAG_OTA_SLOT_INDEX, "Ignoring malformed entry for %s", partition->label);
+        return false;
+    }
+
+    header.version[sizeof(header.version) - 1] = '\0';
+    out.version = header.version;
+    out.imageSize = header.imageSize;
+    out.checksum.assign(header.checksum, sizeof(header.checksum));
+    out.signature.assign(blob.begin() + sizeof(header), blob.end());
+    return true;
+}
+
+bool SlotIndex::record(const esp_partition_t *partition, const SlotImage &image)
+{
+    if (image.checksum.size() != sizeof(RecordHeader::checksum) || image.signature.size() > UINT16_MAX)
+    {
+        ESP_LOGE(TAG_OTA_SLOT_INDEX, "Cannot index firmware %s: unexpected checksum or signature size",
+                 image.version.c_str());
+        return false;
+    }
+
+    RecordHeader header = {};
+    header.imageSize = image.imageSize;
+    header.signatureLen = static_cast<uint16_t>(image.signature.size());
+    strncpy(header.version, image.version.c_str(), sizeof(header.version) - 1);
+    memcpy(header.checksum, image.checksum.data(), sizeof(header.checksum));
+
+    // Sized once and filled with memcpy; growing from the header copy trips -Warray-bounds on GCC 12
+    std::vector<uint8_t> blob(sizeof(header) + image.signature.size());
+    memcpy(blob.data(), &header, sizeof(header));
+    if (!image.signature.empty())
+    {
+        memcpy(blob.data() + sizeof(header), image.signature.data(), image.signature.size());
+    }
+    if (!nvs.storeBlob(keyFor(partition), blob))
+    {
+        ESP_LOGE(TAG_OTA_SLOT_INDEX, "Failed to index firmware %s in %s", header.version, partition->label);
+        return false;
+    }
+    ESP_LOGI(TAG_OTA_SLOT_INDEX, "%s holds firmware %s (%" PRIu32 " bytes)", partition->label, header.version,
+             header.imageSize);
+    return true;
+}
+
+void SlotIndex::forget(const esp_partition_t *partition)
+{
+    nvs.eraseKey(keyFor(partition));
+}
+
+bool SlotIndex::holds(const esp_partition_t *partition, const std::string &version)
+{
+    SlotImage image;
+    return lookup(partition, image) && image.version == version;
+}
@@ -20,8 +20,18 @@ extern "C"
 #include "esp_wifi.h"
 }
 
+#include <algorithm>
+#include <cstring>
+
 #include "Common/certificates.h"
+#include "Common/CredentialStore.h"
+#include "Common/DeviceIdentity.h"
+#include "Common/MqttMessageAssembler.h"
 #include "OTAUpdateManager/OTAUpdateManager.h"
+#include "OTAUpdateManager/ImageAttestor.h"
+#include "OTAUpdateManager/ActivationManager.h"
+#include "OTAUpdateManager/BootHealthCheck.h"
+#include "ConnectivityManager/ConnectivityManager.h"
 
 inline const char *TAG = "Main App";
 
@@ -29,15 +39,34 @@ inline const char *TAG = "Main App";
 #define WIFI_PASS "..........."
 #define MQTT_BROKER_URI "mqtts://xxxxxxxxxxx.iot.eu-north-1.amazonaws.com"
 
-int retry_num = 0;
+// A new image must reach IP, MQTT and a granted firmware topic subscription this long after boot
+#ifndef OTA_HEALTH_DEADLINE_MS
+#define OTA_HEALTH_DEADLINE_MS 60000
+#endif
+
+// Largest MQTT message reassembled from fragments; update commands are around 1-2 KB
+#ifndef MQTT_MAX_MESSAGE_SIZE
+#define MQTT_MAX_MESSAGE_SIZE 8192
+#endif
+
+// How long app_main waits for an IP before starting MQTT and the application anyway
+#ifndef WIFI_CONNECT_TIMEOUT_MS
+#define WIFI_CONNECT_TIMEOUT_MS 15000
+#endif
+
+static ConnectivityManager connectivity;
+static DeviceIdentity identity;
 static esp_mqtt_client_handle_t mqtt_client = nullptr;
+static MqttMessageAssembler mqtt_assembler(MQTT_MAX_MESSAGE_SIZE);
 char device_firmware_topic[64];
+char device_status_topic[64];
+char device_attest_topic[64];
+char device_attest_result_topic[72];
+char device_activate_topic[64];
 
-static void wifi_init();
 static void mqtt_init();
 static esp_err_t mqtt_event_handler_cb(esp_mqtt_event_handle_t event);
 static void mqtt_event_handler(void *handler_args, esp_event_base_t base, int32_t event_id, void *event_data);
-static void wifi_event_handler(void *event_handler_arg, esp_event_base_t event_base, int32_t event_id, void *event_data);
 
 void generate_device_firmware_topic() {
     uint8_t mac[6];
@@ -52,61 +81,20 @@ void generate_device_firmware_topic() {
              "firmware_update/%02X:%02X:%02X:%02X:%02X:%02X",
              mac[0], mac[1], mac[2], mac[3], mac[4], mac[5]);
 
-    ESP_LOGI(TAG, "Device-specific topic: %s", device_firmware_topic);
-}
-
-
-static void wifi_event_handler(void *event_handler_arg, esp_event_base_t event_base, int32_t event_id, void *event_data)
-{
-  if (event_id == WIFI_EVENT_STA_START)
-  {
-    printf("WIFI CONNECTING....\n");
-  }
-  else if (event_id == WIFI_EVENT_STA_CONNECTED)
-  {
-    printf("WiFi CONNECTED\n");
-  }
-  else if (event_id == WIFI_EVENT_STA_DISCONNECTED)
-  {
-    printf("WiFi lost connection\n");
-    if (retry_num < 5)
-    {
-      esp_wifi_connect();
-      retry_num++;
-      printf("Retrying to Connect...\n");
-    }
-  }
-  else if (event_id == IP_EVENT_STA_GOT_IP)
-  {
-    printf("Wifi got IP...\n\n");
-  }
-}
-
-static void wifi_init()
-{
-  esp_netif_init();
-  esp_event_loop_create_default();     // event loop
-  esp_netif_create_default_wifi_sta(); // WiFi station
-  wifi_init_config_t wifi_initiation = WIFI_INIT_CONFIG_DEFAULT();
-  esp_wifi_init(&wifi_initiation);
-
-  esp_event_handler_register(WIFI_EVENT, ESP_EVENT_ANY_ID, wifi_event_handler, NULL);
-  esp_event_handler_register(IP_EVENT, IP_EVENT_STA_GOT_IP, wifi_event_handler, NULL);
-
-  wifi_config_t wifi_configuration = {};
-  strcpy((char *)wifi_configuration.sta.ssid, WIFI_SSID);
-  strcpy((char *)wifi_configuration.sta.password, WIFI_PASS);
-
-  strcpy((char *)wifi_configuration.sta.ssid, WIFI_SSID);
-  strcpy((char *)wifi_configuration.sta.password, WIFI_PASS);
+    snprintf(device_status_topic, sizeof(device_status_topic),
+             "firmware_status/%02X:%02X:%02X:%02X:%02X:%02X",
+             mac[0], mac[1], mac[2], mac[3], mac[4], mac[5]);
 
-  esp_wifi_set_config(WIFI_IF_STA, &wifi_configuration);
+    snprintf(device_attest_topic, sizeof(device_attest_topic),
+             "firmware_attest/%02X:%02X:%02X:%02X:%02X:%02X",
+             mac[0], mac[1], mac[2], mac[3], mac[4], mac[5]);
+    snprintf(device_attest_result_topic, sizeof(device_attest_result_topic), "%s/result", device_attest_topic);
 
-  esp_wifi_start();
-  esp_wifi_set_mode(WIFI_MODE_STA);
-  esp_wifi_connect();
+    snprintf(device_activate_topic, sizeof(device_activate_topic),
+             "firmware_activate/%02X:%02X:%02X:%02X:%02X:%02X",
+             mac[0], mac[1], mac[2], mac[3], mac[4], mac[5]);
 
-  printf("wifi_init_softap finished. SSID:%s  password:%s\n", WIFI_SSID, WIFI_PASS);
+    ESP_LOGI(TAG, "Device-specific topic: %s", device_firmware_topic);
 }
 
 static esp_err_t mqtt_event_handler_cb(esp_mqtt_event_handle_t event)
@@ -116,29 +104,86 @@ static esp_err_t mqtt_event_handler_cb(esp_mqtt_event_handle_t event)
   case MQTT_EVENT_CONNECTED:
     ESP_LOGI(TAG, "MQTT Connected");
     esp_mqtt_client_subscribe(mqtt_client, "firmware_update", 0);
-    esp_mqtt_client_subscribe(mqtt_client, device_firmware_topic, 0);
+    BootHealthCheck::instance().onMqttConnected(esp_mqtt_client_subscribe(mqtt_client, device_firmware_topic, 0));
+    esp_mqtt_client_subscribe(mqtt_client, device_attest_topic, 0);
+    for (const std::string &cohort : identity.cohortTopics())
+    {
+      esp_mqtt_client_subscribe(mqtt_client, cohort.c_str(), 0);
+    }
+    esp_mqtt_client_subscribe(mqtt_client, "firmware_activate", 0);
+    esp_mqtt_client_subscribe(mqtt_client, device_activate_topic, 0);
+    for (const std::string &cohort : identity.activationTopics())
+    {
+      esp_mqtt_client_subscribe(mqtt_client, cohort.c_str(), 0);
+    }
+    {
+      // Report what we run so the cloud can drop an already-applied retained command
+      std::string report = ota_build_status_report();
+      if (esp_mqtt_client_publish(mqtt_client, device_status_topic, report.c_str(), report.size(), 1, 0) >= 0)
+      {
+        connectivity.markFirstPublish();
+      }
+    }
     break;
   case MQTT_EVENT_DISCONNECTED:
     ESP_LOGI(TAG, "MQTT Disconnected");
     break;
   case MQTT_EVENT_SUBSCRIBED:
     ESP_LOGI(TAG, "Subscribed to topic");
+    // The SUBACK return code is in the event data; 0x80 means the broker refused the topic
+    if (BootHealthCheck::instance().onSubscribed(event->msg_id,
+                                                 event->data_len < 1 || (uint8_t)event->data[0] != 0x80))
+    {
+      // Report the health check outcome now rather than on the next connect
+      std::string report = ota_build_status_report();
+      esp_mqtt_client_publish(mqtt_client, device_status_topic, report.c_str(), report.size(), 1, 0);
+    }
     break;
   case MQTT_EVENT_DATA:
+  {
+    // Messages over the client's receive buffer arrive in several events; act on whole ones only
+    if (!mqtt_assembler.feed(event->topic, event->topic_len, event->data, event->data_len,
+                             event->current_data_offset, event->total_data_len))
+    {
+      break;
+    }
+    const char *topic = mqtt_assembler.topic().c_str();
+    int topic_len = mqtt_assembler.topic().size();
+    const char *data = mqtt_assembler.payload().data();
+    int data_len = mqtt_assembler.payload().size();
+
     ESP_LOGI(TAG, "Received MQTT Message");
-    printf("Topic: %.*s\n", event->topic_len, event->topic);
-    printf("Data: %.*s\n", event->data_len, event->data);
+    printf("Topic: %.*s\n", topic_len, topic);
+    printf("Data: %.*s\n", data_len, data);
 
     // Check for firmware Update..
-    if ((event->topic_len == strlen("firmware_update") &&
-         strncmp((const char *)event->topic, "firmware_update", event->topic_len) == 0) ||
-        (event->topic_len == strlen(device_firmware_topic) &&
-         strncmp((const char *)event->topic, device_firmware_topic, event->topic_len) == 0))
+    if ((topic_len == strlen("firmware_update") &&
+         strncmp(topic, "firmware_update", topic_len) == 0) ||
+        (topic_len == strlen(device_firmware_topic) &&
+         strncmp(topic, device_firmware_topic, topic_len) == 0) ||
+        identity.isCohortTopic(topic, topic_len))
+    {
+      ota_start_update_task(data, data_len);
+    }
+    // Activate staged firmware: {"version": ...} must match what is staged
+    else if ((topic_len == strlen("firmware_activate") &&
+              strncmp(topic, "firmware_activate", topic_len) == 0) ||
+             (topic_len == strlen(device_activate_topic) &&
+              strncmp(topic, device_activate_topic, topic_len) == 0) ||
+             identity.isActivationTopic(topic, topic_len))
+    {
+      ota_handle_activate_command(data, data_len);
+    }
+    // Attestation request: the payload is an optional nonce echoed back in the result
+    else if (topic_len == strlen(device_attest_topic) &&
+             strncmp(topic, device_attest_topic, topic_len) == 0)
     {
-      auto *params = new ota_task_params_t{std::string(event->data, event->data_len)};
-      xTaskCreate(&ota_update_task, "ota_update_task", 8192, params, 5, NULL);
+      std::string nonce(data, std::min(data_len, 64));
+      std::string report = ImageAttestor::instance().buildReport(nonce);
+      esp_mqtt_client_publish(mqtt_client, device_attest_result_topic, report.c_str(), report.size(), 1, 0);
     }
     break;
+  }
   default:
     break;
   }
@@ -158,12 +203,25 @@ static void mqtt_init()
   // Set broker URI
   mqtt_cfg.broker.address.uri = MQTT_BROKER_URI;
 
-  // Set TLS client certificate and private key
-  mqtt_cfg.credentials.authentication.certificate = IoT_CLIENT_CERT;
-  mqtt_cfg.credentials.authentication.key = IoT_PRIVATE_KEY;
+  CredentialStore &credentials = CredentialStore::instance();
+  if (credentials.hasGlobalCaStore())
+  {
+    // Build-time DER in flash and the shared CA store: no PEM decode or CA parse per (re)connect
+    mqtt_cfg.credentials.authentication.certificate = (const char *)credentials.clientCertDer().data;
+    mqtt_cfg.credentials.authentication.certificate_len = credentials.clientCertDer().size;
+    mqtt_cfg.credentials.authentication.key = (const char *)credentials.clientKeyDer().data;
+    mqtt_cfg.credentials.authentication.key_len = credentials.clientKeyDer().size;
+    mqtt_cfg.broker.verification.use_global_ca_store = true;
+  }
+  else
+  {
+    // Set TLS client certificate and private key
+    mqtt_cfg.credentials.authentication.certificate = IoT_CLIENT_CERT;
+    mqtt_cfg.credentials.authentication.key = IoT_PRIVATE_KEY;
 
-  // CA certificate
-  mqtt_cfg.broker.verification.certificate = AWS_CA_CERT;
+    // CA certificate
+    mqtt_cfg.broker.verification.certificate = AWS_CA_CERT;
+  }
 
   // Setup the MQTT client
   mqtt_client = esp_mqtt_client_init(&mqtt_cfg);
@@ -185,13 +243,39 @@ extern "C" void app_main(void)
     ESP_LOGI(TAG, "OTA-Boot Loader Started...");
 
     nvs_flash_init();
-    wifi_init();
 
-    // Delay to allow WiFi connection to establish before starting MQTT
-    vTaskDelay(5000 / portTICK_PERIOD_MS);
+    // Commits a staged version now running, before anything reads the firmware version
+    ActivationManager::instance().finalizePendingActivation();
+
+    // A new image pending verification rolls back unless it is healthy before the deadline
+    BootHealthCheck::instance().begin(OTA_HEALTH_DEADLINE_MS);
+
     generate_device_firmware_topic();
+    identity.load();
+    CredentialStore::instance().begin();
+
+    // Health stage follows the IP event, including an IP that arrives after the wait below
+    connectivity.setIpCallback([] { BootHealthCheck::instance().onGotIp(); });
+    if (!connectivity.begin(WIFI_SSID, WIFI_PASS))
+    {
+        ESP_LOGE(TAG, "Wi-Fi init failed");
+    }
+
+    // Image digest is cached in NVS and goes into the first status report; recomputation
+    // runs at low priority in the background
+    ImageAttestor::instance().start();
+
+    // MQTT starts as soon as we have an IP. Without one it starts after the timeout
+    // and keeps retrying on its own, so the rest of app_main still runs.
+    if (!connectivity.waitForIp(pdMS_TO_TICKS(WIFI_CONNECT_TIMEOUT_MS)))
+    {
+        ESP_LOGW(TAG, "No IP after %d ms, continuing offline", WIFI_CONNECT_TIMEOUT_MS);
+    }
     mqtt_init();
 
+    // Re-arms a maintenance window for firmware staged before this boot
+    ActivationManager::instance().start();
+
 
     // --- Main APP Logic ----
 
@@ -1,5 +1,7 @@
 #!/usr/bin/env node
 const { deployPipeline } = require('./scripts/deploy');
+const { activatePipeline } = require('./scripts/activate');
+const { rollbackPipeline } = require('./scripts/rollback');
 const os = require('os');
 const logger = require('./services/logger');
 
@@ -16,12 +18,36 @@ const getArgValue = (key) => {
 const firmwareVersion = getArgValue('version');
 const changelog = getArgValue('changelog');
 const targetFile = getArgValue('target');  
+const cohorts = getArgValue('cohort');
+const activation = getArgValue('activation');
 const deployedBy = os.userInfo().username;
 
 (async () => {
+  if (args[0] === 'activate') {
+    if (!firmwareVersion) {
+      logger.error('\n Missing required arguments.\n');
+      logger.info('Usage: activate --version=<version> [--target=<filename>] [--cohort=<hw_rev|site|ring>:<value>,...]\n');
+      process.exit(1);
+    }
+
+    await activatePipeline({ firmwareVersion, targetFile, cohorts });
+    return;
+  }
+
+  if (args[0] === 'rollback') {
+    if (!firmwareVersion) {
+      logger.error('\n Missing required arguments.\n');
+      logger.info('Usage: rollback --version=<version> [--target=<filename>] [--cohort=<hw_rev|site|ring>:<value>,...] [--activation=<immediate|next_boot|command|window:HH:MM-HH:MM>]\n');
+      process.exit(1);
+    }
+
+    await rollbackPipeline({ firmwareVersion, targetFile, cohorts, activation });
+    return;
+  }
+
   if (!changelog) {
     logger.error('\n Missing required arguments.\n');
-    logger.info('Usage: deploy --version=<version> --changelog="<description>" [--target=<filename>]\n');
+    logger.info('Usage: deploy --version=<version> --changelog="<description>" [--target=<filename>] [--cohort=<hw_rev|site|ring>:<value>,...] [--activation=<immediate|next_boot|command|window:HH:MM-HH:MM>]\n');
     process.exit(1);
   }
 
@@ -30,5 +56,7 @@ const deployedBy = os.userInfo().username;
     changelog,
     deployedBy,
     targetFile,
+    cohorts,
+    activation,
   });
 })();
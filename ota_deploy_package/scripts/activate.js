@@ -0,0 +1,27 @@
+const { getTargetMACsFromFile, getCohortTopics } = require('./targetList');
+const { triggerActivation } = require('./lambda');
+const { checkVersionExists } = require('./db');
+const logger = require('../services/logger');
+
+// Activates a release that devices downloaded with a deferred activation policy.
+// Devices ignore the command unless they have exactly this version staged.
+async function activatePipeline({ firmwareVersion, targetFile, cohorts }) {
+  try {
+    const topics = [
+      ...(cohorts ? getCohortTopics(cohorts, 'firmware_activate') : []),
+      ...(targetFile ? getTargetMACsFromFile(targetFile).map((mac) => `firmware_activate/${mac}`) : []),
+    ];
+
+    if (!(await checkVersionExists(firmwareVersion))) {
+      logger.error(`Version ${firmwareVersion} was never deployed.`);
+      return;
+    }
+
+    logger.info(`Activating firmware ${firmwareVersion} on ${topics.length ? topics.join(', ') : 'all devices'}`);
+    await triggerActivation({ version: firmwareVersion, topics: topics.length ? topics : ['firmware_activate'] });
+  } catch (err) {
+    logger.error(`Activation failed: ${err.message}`);
+  }
+}
+
+module.exports = { activatePipeline };
@@ -84,4 +84,24 @@ async function getLatestVersion() {
   return parts.join('.');
 }
 
-module.exports = { saveMetadata, checkVersionExists, getLatestVersion };
+// Fetch the stored metadata of a deployed version, or null
+async function getRelease(version) {
+  const client = new Client({
+    connectionString: process.env.POSTGRES_URL,
+    ssl: {
+      ca: fs.readFileSync(certPath).toString(),
+      rejectUnauthorized: true
+    }
+  });
+
+  const relation = process.env.FIRMWARE_RELATION;
+  await client.connect();
+
+  const query = `SELECT firmware_path, signature_path, checksum FROM ${relation} WHERE firmware_version = $1`;
+  const res = await client.query(query, [version]);
+
+  await client.end();
+  return res.rowCount > 0 ? res.rows[0] : null;
+}
+
+module.exports = { saveMetadata, checkVersionExists, getLatestVersion, getRelease };
@@ -2,18 +2,60 @@ const { buildFirmware } = require('./buildPlatformIO');
 const { signFirmware } = require('./signer');
 const { uploadFirmware } = require('./s3Uploader');
 const { checkVersionExists, saveMetadata, getLatestVersion } = require('./db');
-const { getTargetMACsFromFile } = require('./targetList');
+const { getTargetMACsFromFile, getCohortTopics } = require('./targetList');
 const { triggerLambda } = require('./lambda');
 const logger = require('../services/logger');
 const fs = require('fs');
 const path = require('path');
 require('dotenv').config({ path: path.resolve(__dirname, '../.env') });
 
+// Per-device topics published by one Lambda invocation, and invocations in flight at once
+const TOPICS_PER_INVOCATION = parseInt(process.env.TOPICS_PER_INVOCATION, 10) || 100;
+const FANOUT_CONCURRENCY = parseInt(process.env.FANOUT_CONCURRENCY, 10) || 8;
 
-async function deployPipeline({ firmwareVersion, changelog, deployedBy }) {
+function toBatches(items, size) {
+  const batches = [];
+  for (let i = 0; i < items.length; i += size) {
+    batches.push(items.slice(i, i + size));
+  }
+  return batches;
+}
+
+async function runWithConcurrency(tasks, limit) {
+  let next = 0;
+  const workers = Array.from({ length: Math.min(limit, tasks.length) }, async () => {
+    while (next < tasks.length) {
+      await tasks[next++]();
+    }
+  });
+  await Promise.all(workers);
+}
+
+
+// "immediate" | "next_boot" | "command" | "window:HH:MM-HH:MM" (UTC) -> command.activation
+function parseActivation(spec) {
+  const [policy, ...rest] = spec.split(':');
+  const window = rest.join(':');
+  if (['immediate', 'next_boot', 'command'].includes(policy) && !window) {
+    return { policy };
+  }
+  const [start, end] = window.split('-');
+  if (policy === 'window' && /^([01]\d|2[0-3]):[0-5]\d-([01]\d|2[0-3]):[0-5]\d$/.test(window) && start !== end) {
+    return { policy, window };
+  }
+  throw new Error(`Invalid activation "${spec}". Expected immediate|next_boot|command|window:HH:MM-HH:MM`);
+}
+
+
+async function deployPipeline({ firmwareVersion, changelog, deployedBy, targetFile, cohorts, activation }) {
   try {
     logger.info('Starting OTA update deployment...');
 
+    // Resolve targets first so a bad --cohort or --target fails before building
+    const cohortTopics = cohorts ? getCohortTopics(cohorts) : [];
+    const deviceTopics = targetFile ? getTargetMACsFromFile(targetFile).map((mac) => `firmware_update/${mac}`) : [];
+    const activationPolicy = activation ? parseActivation(activation) : undefined;
+
     // Version check..
     if (!firmwareVersion) {
       firmwareVersion = await getLatestVersion();
@@ -30,16 +72,18 @@ async function deployPipeline({ firmwareVersion, changelog, deployedBy }) {
     await buildFirmware();
 
     // Sign firmware
-    const { signature, checksum } = await signFirmware();
+    const { signature, checksum, encryption, encryptedPath } = await signFirmware({ version: firmwareVersion });
 
-    // Upload firmware
-    const firmwarePath = path.resolve(process.env.FIRMWARE_PATH);
+    // Upload firmware and signature in parallel
+    // Encrypted releases upload only the ciphertext; signature and checksum cover the plaintext
+    const firmwarePath = path.resolve(encryptedPath || process.env.FIRMWARE_PATH);
     const firmwareKey = `firmwares/${firmwareVersion}.bin`;
-    const firmwareUrl = await uploadFirmware(firmwarePath, firmwareKey);
-
     const signaturePath = path.resolve(process.env.SIGNATURE_PATH);
     const sigKey = `signatures/${firmwareVersion}.sig`;
-    const sigUrl = await uploadFirmware(signaturePath, sigKey);
+    const [firmwareUrl, sigUrl] = await Promise.all([
+      uploadFirmware(firmwarePath, firmwareKey),
+      uploadFirmware(signaturePath, sigKey)
+    ]);
 
     // Save metadata to DB
     await saveMetadata({
@@ -54,28 +98,38 @@ async function deployPipeline({ firmwareVersion, changelog, deployedBy }) {
     // API URL..
     const apiGatewayFirmwareDownloadUrl = `${process.env.API_GATEWAY_BASE_URL}/firmware/${firmwareVersion}`;
 
-    // Trigger Lambda
-    if (targetFile) {
-      const macList = getTargetMACsFromFile(targetFile);
-      for (const mac of macList) {
-        const topic = `firmware_update/${mac}`;
-        logger.info(`Triggering OTA update for MAC: ${mac} on topic: ${topic}`);
-        await triggerLambda({
-          version: firmwareVersion,
-          firmwareUrl: apiGatewayFirmwareDownloadUrl,
-          signatureUrl: sigUrl,
-          checksum: checksum,
-          topic: topic
-        });
-      }
-    } else {
-      await triggerLambda({
-        version: firmwareVersion,
-        firmwareUrl: apiGatewayFirmwareDownloadUrl,
-        signatureUrl: sigUrl,
-        checksum: checksum,
-        topic: 'firmware_update'
-      });
+    // Ranked download mirrors, API Gateway first; devices fail over between them
+    const firmwareUrls = [apiGatewayFirmwareDownloadUrl, ...(process.env.FIRMWARE_MIRROR_URLS || '')
+      .split(',')
+      .map((template) => template.trim())
+      .filter(Boolean)
+      .map((template) => template.replace('{version}', firmwareVersion))];
+
+    const command = {
+      version: firmwareVersion,
+      firmwareUrl: apiGatewayFirmwareDownloadUrl,
+      firmwareUrls,
+      signatureUrl: sigUrl,
+      signature: signature.toString('base64'),
+      checksum: checksum,
+      encryption,
+      activation: activationPolicy
+    };
+
+    // Trigger Lambda: one publish per cohort, per-device targets in batched parallel invocations
+    if (cohortTopics.length) {
+      logger.info(`Triggering OTA update for cohorts: ${cohortTopics.join(', ')}`);
+      await triggerLambda({ ...command, topics: cohortTopics });
+    }
+
+    if (deviceTopics.length) {
+      const batches = toBatches(deviceTopics, TOPICS_PER_INVOCATION);
+      logger.info(`Triggering OTA update for ${deviceTopics.length} devices in ${batches.length} batches`);
+      await runWithConcurrency(batches.map((topics) => () => triggerLambda({ ...command, topics })), FANOUT_CONCURRENCY);
+    }
+
+    if (!cohortTopics.length && !deviceTopics.length) {
+      await triggerLambda({ ...command, topic: 'firmware_update' });
     }
 
 
@@ -83,8 +137,9 @@ async function deployPipeline({ firmwareVersion, changelog, deployedBy }) {
       - Version     : ${firmwareVersion}
       - Deployed By : ${deployedBy}
       - Changelog   : ${changelog}
-      - Firmware URL: ${apiGatewayFirmwareDownloadUrl}
-      - Signature URL: ${sigUrl}`);
+      - Firmware URL: ${firmwareUrls.join(', ')}
+      - Signature URL: ${sigUrl}
+      - Activation  : ${activation || 'immediate'}`);
 
     // logger.success('OTA update deployed successfully!');
   } catch (err) {
@@ -100,4 +155,4 @@ async function deployPipeline({ firmwareVersion, changelog, deployedBy }) {
   }
 }
 
-module.exports = { deployPipeline };
+module.exports = { deployPipeline, parseActivation };
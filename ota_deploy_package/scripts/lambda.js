@@ -7,19 +7,8 @@ const lambda = new AWS.Lambda({
   region: process.env.AWS_REGION 
 });
 
-async function triggerLambda(metadata) {
+async function invokeLambda(payload) {
   try {
-    const payload = {
-      action: "ota_update",
-      data: {
-        version: metadata.version,
-        firmware_url: metadata.firmwareUrl,
-        signature_url: metadata.signatureUrl,
-        checksum: metadata.checksum,
-        topic: metadata.topic
-      }
-    };
-
     const result = await lambda.invoke({
       FunctionName: process.env.LAMBDA_FUNCTION_NAME, 
       Payload: JSON.stringify(payload),
@@ -41,4 +30,31 @@ async function triggerLambda(metadata) {
   }
 }
 
-module.exports = { triggerLambda };
+async function triggerLambda(metadata) {
+  await invokeLambda({
+    action: "ota_update",
+    data: {
+      version: metadata.version,
+      firmware_url: metadata.firmwareUrl,
+      firmware_urls: metadata.firmwareUrls,
+      signature_url: metadata.signatureUrl,
+      signature: metadata.signature,
+      checksum: metadata.checksum,
+      encryption: metadata.encryption,
+      activation: metadata.activation,
+      rollback: metadata.rollback,
+      topic: metadata.topic,
+      topics: metadata.topics
+    }
+  });
+}
+
+// Tells devices that staged `version` to switch to it and restart
+async function triggerActivation({ version, topics }) {
+  await invokeLambda({
+    action: "activate",
+    data: { version, topics }
+  });
+}
+
+module.exports = { triggerLambda, triggerActivation };
@@ -0,0 +1,41 @@
+const { getTargetMACsFromFile, getCohortTopics } = require('./targetList');
+const { triggerLambda } = require('./lambda');
+const { getRelease } = require('./db');
+const { parseActivation } = require('./deploy');
+const logger = require('../services/logger');
+const path = require('path');
+require('dotenv').config({ path: path.resolve(__dirname, '../.env') });
+
+// Re-publishes a previously deployed release as a rollback, which devices accept even
+// though it is older. Devices whose inactive slot still holds it re-verify the slot and
+// switch to it without downloading; others download it.
+async function rollbackPipeline({ firmwareVersion, targetFile, cohorts, activation }) {
+  try {
+    const topics = [
+      ...(cohorts ? getCohortTopics(cohorts) : []),
+      ...(targetFile ? getTargetMACsFromFile(targetFile).map((mac) => `firmware_update/${mac}`) : []),
+    ];
+    const activationPolicy = activation ? parseActivation(activation) : undefined;
+
+    const release = await getRelease(firmwareVersion);
+    if (!release) {
+      logger.error(`Version ${firmwareVersion} was never deployed.`);
+      return;
+    }
+
+    logger.info(`Rolling ${topics.length ? topics.join(', ') : 'all devices'} to firmware ${firmwareVersion}`);
+    await triggerLambda({
+      version: firmwareVersion,
+      firmwareUrl: `${process.env.API_GATEWAY_BASE_URL}/firmware/${firmwareVersion}`,
+      signatureUrl: release.signature_path,
+      checksum: release.checksum,
+      activation: activationPolicy,
+      rollback: true,
+      ...(topics.length ? { topics } : { topic: 'firmware_update' }),
+    });
+  } catch (err) {
+    logger.error(`Rollback failed: ${err.message}`);
+  }
+}
+
+module.exports = { rollbackPipeline };
@@ -3,9 +3,65 @@ require('dotenv').config({ path: path.resolve(__dirname, '../.env') });
 
 const fs = require('fs');
 const crypto = require('crypto');
+const { execFileSync } = require('child_process');
 const logger = require('../services/logger');
 
-function signFirmware() {
+
+// Streams the image once through the native packager (tools/ota-pack) and reads back its manifest.
+function signWithOtaPack({ otaPackBin, privateKeyPath, firmwarePath, signaturePath, version, kekPath }) {
+  const outDir = path.dirname(path.resolve(signaturePath));
+  execFileSync(otaPackBin, [
+    `--key=${privateKeyPath}`,
+    `--version=${version}`,
+    `--out-dir=${outDir}`,
+    ...(kekPath ? [`--encrypt-kek=${kekPath}`] : []),
+    firmwarePath
+  ], { stdio: 'inherit' });
+
+  const manifest = JSON.parse(fs.readFileSync(path.join(outDir, 'manifest.json'), 'utf-8'));
+  const image = manifest.images[0];
+  const packedSigPath = path.join(outDir, image.signature_file);
+  if (path.resolve(packedSigPath) !== path.resolve(signaturePath)) {
+    fs.renameSync(packedSigPath, signaturePath);
+  }
+
+  logger.success(`Signature (binary) written to ${signaturePath} by ota-pack`);
+  logger.success(`Checksum (SHA-256): ${image.checksum}`);
+
+  const result = {
+    signature: Buffer.from(image.signature, 'base64'),
+    checksum: image.checksum
+  };
+  if (image.encryption) {
+    const { file, ...encryption } = image.encryption;
+    result.encryption = encryption;
+    result.encryptedPath = path.join(outDir, file);
+    logger.success(`Encrypted image written to ${result.encryptedPath}`);
+  }
+  return result;
+}
+
+// AES-256-CTR under a fresh release key, wrapped with the fleet KEK (RFC 3394). Same output as ota-pack.
+function encryptFirmware(firmware, kekPath, firmwarePath) {
+  const kek = fs.readFileSync(kekPath);
+  if (kek.length !== 32) throw new Error(`Key-encryption key must be 32 raw bytes: ${kekPath}`);
+
+  const releaseKey = crypto.randomBytes(32);
+  const iv = crypto.randomBytes(16);
+  const wrap = crypto.createCipheriv('id-aes256-wrap', kek, Buffer.from('A6A6A6A6A6A6A6A6', 'hex'));
+  const wrappedKey = Buffer.concat([wrap.update(releaseKey), wrap.final()]);
+  const cipher = crypto.createCipheriv('aes-256-ctr', releaseKey, iv);
+  const encryptedPath = `${firmwarePath}.enc`;
+  fs.writeFileSync(encryptedPath, Buffer.concat([cipher.update(firmware), cipher.final()]));
+  logger.success(`Encrypted image written to ${encryptedPath}`);
+
+  return {
+    encryption: { alg: 'aes-256-ctr', wrapped_key: wrappedKey.toString('base64'), iv: iv.toString('base64') },
+    encryptedPath
+  };
+}
+
+function signFirmware({ version } = {}) {
   try {
     logger.info('Signing firmware and generating checksum...');
 
@@ -22,6 +78,19 @@ function signFirmware() {
     if (!fs.existsSync(firmwarePath)) throw new Error(`Firmware not found: ${firmwarePath}`);
     if (!fs.existsSync(privateKeyPath)) throw new Error(`Private key not found: ${privateKeyPath}`);
 
+    // Optional fleet key-encryption key; when set, the uploaded image is encrypted
+    const kekPath = process.env.OTA_ENCRYPT_KEK
+      ? process.env.OTA_ENCRYPT_KEK.replace('%USERPROFILE%', process.env.USERPROFILE)
+      : '';
+    if (kekPath && !fs.existsSync(kekPath)) throw new Error(`Key-encryption key not found: ${kekPath}`);
+
+    // A configured but missing ota-pack is a setup error, not a reason to sign differently
+    const otaPackBin = process.env.OTA_PACK_BIN;
+    if (otaPackBin && !fs.existsSync(otaPackBin)) throw new Error(`OTA_PACK_BIN not found: ${otaPackBin}`);
+    if (otaPackBin) {
+      return signWithOtaPack({ otaPackBin, privateKeyPath, firmwarePath, signaturePath, version: version || '0.0.0', kekPath });
+    }
+
     // Load firmware and private key
     const firmware = fs.readFileSync(firmwarePath);
     const privateKeyPem = fs.readFileSync(privateKeyPath, 'utf-8');
@@ -42,7 +111,8 @@ function signFirmware() {
 
     return {
       signature: signatureBuffer,
-      checksum: checksumHex
+      checksum: checksumHex,
+      ...(kekPath ? encryptFirmware(firmware, kekPath, firmwarePath) : {})
     };
   } catch (err) {
     logger.error('Failed to sign firmware: ' + err.message);
@@ -17,4 +17,19 @@ function getTargetMACsFromFile(filePath) {
   }
 }
 
-module.exports = { getTargetMACsFromFile };
+// Cohort keys the device reads from its NVS "identity" namespace
+const COHORT_KEYS = ['hw_rev', 'site', 'ring'];
+
+// Parses "ring:canary,site:berlin" into cohort topics, e.g. firmware_update/ring/canary
+// (firmware_activate/ring/canary with the activation prefix)
+function getCohortTopics(spec, prefix = 'firmware_update') {
+  return spec.split(',').map((entry) => entry.trim()).filter(Boolean).map((entry) => {
+    const [key, value] = entry.split(':').map((part) => (part || '').trim());
+    if (!COHORT_KEYS.includes(key) || !value || /[/+#]/.test(value)) {
+      throw new Error(`Invalid cohort "${entry}". Expected <${COHORT_KEYS.join('|')}>:<value>`);
+    }
+    return `${prefix}/${key}/${value}`;
+  });
+}
+
+module.exports = { getTargetMACsFromFile, getCohortTopics };
@@ -0,0 +1,390 @@
+#include "Packer.h"
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+
+#include <openssl/pem.h>
+#include <openssl/rand.h>
+#include <openssl/rsa.h>
+#include <zlib.h>
+
+namespace fs = std::filesystem;
+
+namespace
+{
+
+// Bounds how many chunks are queued on the pool at once, so reading stays ahead of hashing only by a little.
+class InFlightLimit
+{
+public:
+    explicit InFlightLimit(size_t limit) : limit(limit) {}
+
+    void acquire()
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        cv.wait(lock, [this]
+                { return count < limit; });
+        ++count;
+    }
+
+    void release()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            --count;
+        }
+        cv.notify_all();
+    }
+
+    void waitIdle()
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        cv.wait(lock, [this]
+                { return count == 0; });
+    }
+
+private:
+    size_t limit;
+    size_t count = 0;
+    std::mutex mutex;
+    std::condition_variable cv;
+};
+
+std::array<uint8_t, 32> sha256(const uint8_t *data, size_t len)
+{
+    std::array<uint8_t, 32> out{};
+    EVP_Digest(data, len, out.data(), nullptr, EVP_sha256(), nullptr);
+    return out;
+}
+
+std::vector<uint8_t> deflateChunk(const std::vector<uint8_t> &data)
+{
+    uLongf outLen = compressBound(data.size());
+    std::vector<uint8_t> out(outLen);
+    if (compress2(out.data(), &outLen, data.data(), data.size(), Z_BEST_COMPRESSION) != Z_OK)
+        throw std::runtime_error("zlib compression failed");
+    out.resize(outLen);
+    return out;
+}
+
+// Reads `path` once, front to back, handing each chunk to `onChunk` on the pool.
+// `onWhole` sees every byte in order on the calling thread and may throw.
+template <typename WholeFn, typename ChunkFn>
+void streamChunks(const std::string &path, size_t chunkSize, ThreadPool &pool, WholeFn onWhole, ChunkFn onChunk)
+{
+    std::ifstream in(path, std::ios::binary);
+    if (!in)
+        throw std::runtime_error("Cannot open " + path);
+
+    const uint64_t size = fs::file_size(path);
+    InFlightLimit inFlight(pool.size() * 2);
+    std::exception_ptr error;
+    std::mutex errorMutex;
+    bool shortRead = false;
+
+    for (uint64_t offset = 0, index = 0; offset < size; offset += chunkSize, ++index)
+    {
+        auto buffer = std::make_shared<std::vector<uint8_t>>(std::min<uint64_t>(chunkSize, size - offset));
+        if (!in.read(reinterpret_cast<char *>(buffer->data()), buffer->size()))
+        {
+            shortRead = true;
+            break;
+        }
+
+        try
+        {
+            onWhole(buffer->data(), buffer->size());
+        }
+        catch (...)
+        {
+            // Drain the pool before unwinding; queued tasks still reference this frame
+            std::lock_guard<std::mutex> lock(errorMutex);
+            error = std::current_exception();
+            break;
+        }
+
+        inFlight.acquire();
+        pool.submit([&, index, buffer]
+                    {
+                        try
+                        {
+                            onChunk(index, buffer);
+                        }
+                        catch (...)
+                        {
+                            std::lock_guard<std::mutex> lock(errorMutex);
+                            error = std::current_exception();
+                        }
+                        inFlight.release(); });
+    }
+
+    inFlight.waitIdle();
+    if (shortRead)
+        throw std::runtime_error("Short read from " + path);
+    if (error)
+        std::rethrow_exception(error);
+}
+
+void writeFile(const fs::path &path, const void *data, size_t len)
+{
+    std::ofstream out(path, std::ios::binary);
+    if (!out.write(static_cast<const char *>(data), len))
+        throw std::runtime_error("Cannot write " + path.string());
+}
+
+void writeU32(std::ofstream &out, uint32_t v)
+{
+    uint8_t le[4] = {uint8_t(v), uint8_t(v >> 8), uint8_t(v >> 16), uint8_t(v >> 24)};
+    out.write(reinterpret_cast<const char *>(le), sizeof(le));
+}
+
+struct MdCtx
+{
+    EVP_MD_CTX *ctx = EVP_MD_CTX_new();
+    ~MdCtx() { EVP_MD_CTX_free(ctx); }
+};
+
+struct CipherCtx
+{
+    EVP_CIPHER_CTX *ctx = EVP_CIPHER_CTX_new();
+    ~CipherCtx() { EVP_CIPHER_CTX_free(ctx); }
+};
+
+const char *const kSignatureSuffix = ".sig";
+const char *const kCompressedSuffix = ".zc";
+const char *const kDeltaSuffix = ".delta";
+const char *const kEncryptedSuffix = ".enc";
+
+// AES-256 key wrap (RFC 3394), unwrapped on the device with mbedtls_nist_kw
+std::vector<uint8_t> wrapKey(const std::vector<uint8_t> &kek, const std::array<uint8_t, 32> &key)
+{
+    CipherCtx cipher;
+    EVP_CIPHER_CTX_set_flags(cipher.ctx, EVP_CIPHER_CTX_FLAG_WRAP_ALLOW);
+    std::vector<uint8_t> out(key.size() + 16);
+    int len = 0, finalLen = 0;
+    if (!EVP_EncryptInit_ex(cipher.ctx, EVP_aes_256_wrap(), nullptr, kek.data(), nullptr) ||
+        !EVP_EncryptUpdate(cipher.ctx, out.data(), &len, key.data(), key.size()) ||
+        !EVP_EncryptFinal_ex(cipher.ctx, out.data() + len, &finalLen))
+        throw std::runtime_error("Key wrap failed");
+    out.resize(len + finalLen);
+    return out;
+}
+
+} // namespace
+
+std::string toHex(const uint8_t *data, size_t len)
+{
+    static const char digits[] = "0123456789abcdef";
+    std::string out(len * 2, '0');
+    for (size_t i = 0; i < len; ++i)
+    {
+        out[2 * i] = digits[data[i] >> 4];
+        out[2 * i + 1] = digits[data[i] & 0x0F];
+    }
+    return out;
+}
+
+std::string toBase64(const std::vector<uint8_t> &data)
+{
+    std::string out(4 * ((data.size() + 2) / 3) + 1, '\0');
+    int n = EVP_EncodeBlock(reinterpret_cast<unsigned char *>(&out[0]), data.data(), data.size());
+    out.resize(n);
+    return out;
+}
+
+Packer::Packer(const std::string &privateKeyPath, const PackOptions &options, ThreadPool &pool)
+    : options(options), pool(pool)
+{
+    FILE *fp = fopen(privateKeyPath.c_str(), "r");
+    if (!fp)
+        throw std::runtime_error("Private key not found: " + privateKeyPath);
+    key = PEM_read_PrivateKey(fp, nullptr, nullptr, nullptr);
+    fclose(fp);
+    if (!key)
+        throw std::runtime_error("Failed to parse private key: " + privateKeyPath);
+}
+
+Packer::~Packer()
+{
+    EVP_PKEY_free(key);
+}
+
+std::vector<uint8_t> Packer::sign(const std::array<uint8_t, 32> &digest)
+{
+    EVP_PKEY_CTX *ctx = EVP_PKEY_CTX_new(key, nullptr);
+    size_t sigLen = 0;
+    bool ok = ctx && EVP_PKEY_sign_init(ctx) > 0 &&
+              EVP_PKEY_CTX_set_signature_md(ctx, EVP_sha256()) > 0 &&
+              (EVP_PKEY_base_id(key) != EVP_PKEY_RSA || EVP_PKEY_CTX_set_rsa_padding(ctx, RSA_PKCS1_PADDING) > 0) &&
+              EVP_PKEY_sign(ctx, nullptr, &sigLen, digest.data(), digest.size()) > 0;
+
+    std::vector<uint8_t> signature(sigLen);
+    ok = ok && EVP_PKEY_sign(ctx, signature.data(), &sigLen, digest.data(), digest.size()) > 0;
+    EVP_PKEY_CTX_free(ctx);
+
+    if (!ok)
+        throw std::runtime_error("Signing failed");
+    signature.resize(sigLen);
+    return signature;
+}
+
+std::vector<std::array<uint8_t, 32>> Packer::hashBaseChunks(const std::string &basePath, std::array<uint8_t, 32> &baseSha256)
+{
+    const uint64_t size = fs::file_size(basePath);
+    std::vector<std::array<uint8_t, 32>> digests((size + options.chunkSize - 1) / options.chunkSize);
+
+    MdCtx md;
+    EVP_DigestInit_ex(md.ctx, EVP_sha256(), nullptr);
+    streamChunks(
+        basePath, options.chunkSize, pool,
+        [&](const uint8_t *data, size_t len)
+        { EVP_DigestUpdate(md.ctx, data, len); },
+        [&](uint64_t index, const std::shared_ptr<std::vector<uint8_t>> &buffer)
+        { digests[index] = sha256(buffer->data(), buffer->size()); });
+    EVP_DigestFinal_ex(md.ctx, baseSha256.data(), nullptr);
+
+    return digests;
+}
+
+std::vector<std::string> Packer::artifactNames(const std::string &imagePath) const
+{
+    const std::string name = fs::path(imagePath).filename().string();
+    std::vector<std::string> names = {name + kSignatureSuffix};
+    if (options.compress)
+        names.push_back(name + kCompressedSuffix);
+    if (!options.baseDir.empty() && fs::exists(fs::path(options.baseDir) / name))
+        names.push_back(name + kDeltaSuffix);
+    if (!options.kek.empty())
+        names.push_back(name + kEncryptedSuffix);
+    return names;
+}
+
+PackedImage Packer::pack(const std::string &imagePath)
+{
+    PackedImage image;
+    image.name = fs::path(imagePath).filename().string();
+    image.size = fs::file_size(imagePath);
+    image.chunks.resize((image.size + options.chunkSize - 1) / options.chunkSize);
+
+    std::vector<std::array<uint8_t, 32>> baseDigests;
+    if (!options.baseDir.empty())
+    {
+        fs::path basePath = fs::path(options.baseDir) / image.name;
+        if (fs::exists(basePath))
+        {
+            baseDigests = hashBaseChunks(basePath.string(), image.baseSha256);
+            image.hasBase = true;
+        }
+    }
+
+    // Chunk payloads are kept only when a delta needs them
+    std::vector<std::shared_ptr<std::vector<uint8_t>>> changedData(image.hasBase ? image.chunks.size() : 0);
+
+    // CTR keeps the ciphertext the same size and lets the device resume decryption at any offset
+    CipherCtx cipher;
+    std::ofstream encrypted;
+    std::vector<uint8_t> cipherBuffer;
+    if (!options.kek.empty())
+    {
+        std::array<uint8_t, 32> releaseKey{};
+        if (RAND_bytes(releaseKey.data(), releaseKey.size()) != 1 || RAND_bytes(image.iv.data(), image.iv.size()) != 1)
+            throw std::runtime_error("RAND_bytes failed");
+        image.wrappedKey = wrapKey(options.kek, releaseKey);
+
+        image.encryptedFile = image.name + kEncryptedSuffix;
+        encrypted.open(fs::path(options.outDir) / image.encryptedFile, std::ios::binary);
+        if (!encrypted || !EVP_EncryptInit_ex(cipher.ctx, EVP_aes_256_ctr(), nullptr, releaseKey.data(), image.iv.data()))
+            throw std::runtime_error("Cannot start encryption of " + image.name);
+        OPENSSL_cleanse(releaseKey.data(), releaseKey.size());
+    }
+
+    MdCtx md;
+    EVP_DigestInit_ex(md.ctx, EVP_sha256(), nullptr);
+    streamChunks(
+        imagePath, options.chunkSize, pool,
+        [&](const uint8_t *data, size_t len)
+        {
+            EVP_DigestUpdate(md.ctx, data, len);
+            if (encrypted.is_open())
+            {
+                int outLen = 0;
+                cipherBuffer.resize(len);
+                if (!EVP_EncryptUpdate(cipher.ctx, cipherBuffer.data(), &outLen, data, len) ||
+                    !encrypted.write(reinterpret_cast<const char *>(cipherBuffer.data()), outLen))
+                    throw std::runtime_error("Encryption failed for " + image.name);
+            }
+        },
+        [&](uint64_t index, const std::shared_ptr<std::vector<uint8_t>> &buffer)
+        {
+            ChunkInfo &chunk = image.chunks[index];
+            chunk.offset = index * options.chunkSize;
+            chunk.size = static_cast<uint32_t>(buffer->size());
+            chunk.sha256 = sha256(buffer->data(), buffer->size());
+            if (image.hasBase)
+            {
+                chunk.unchanged = index < baseDigests.size() && baseDigests[index] == chunk.sha256;
+                if (!chunk.unchanged)
+                    changedData[index] = buffer;
+            }
+            if (options.compress)
+                chunk.compressed = deflateChunk(*buffer);
+        });
+    EVP_DigestFinal_ex(md.ctx, image.sha256.data(), nullptr);
+    if (encrypted.is_open() && !encrypted.flush())
+        throw std::runtime_error("Cannot write " + image.encryptedFile);
+
+    image.signature = sign(image.sha256);
+
+    writeArtifacts(image, changedData);
+    return image;
+}
+
+void Packer::writeArtifacts(PackedImage &image, const std::vector<std::shared_ptr<std::vector<uint8_t>>> &changedData)
+{
+    image.signatureFile = image.name + kSignatureSuffix;
+    writeFile(fs::path(options.outDir) / image.signatureFile, image.signature.data(), image.signature.size());
+
+    if (options.compress)
+    {
+        image.compressedFile = image.name + kCompressedSuffix;
+        std::ofstream out(fs::path(options.outDir) / image.compressedFile, std::ios::binary);
+        for (auto &chunk : image.chunks)
+        {
+            out.write(reinterpret_cast<const char *>(chunk.compressed.data()), chunk.compressed.size());
+            image.compressedSize += chunk.compressed.size();
+        }
+        if (!out)
+            throw std::runtime_error("Cannot write " + image.compressedFile);
+    }
+
+    if (image.hasBase)
+    {
+        // Delta: "OTAD", chunk size, changed count, then (index, size, bytes) per changed chunk
+        image.deltaFile = image.name + kDeltaSuffix;
+        std::ofstream out(fs::path(options.outDir) / image.deltaFile, std::ios::binary);
+        out.write("OTAD", 4);
+        writeU32(out, static_cast<uint32_t>(options.chunkSize));
+        image.changedChunks = std::count_if(image.chunks.begin(), image.chunks.end(),
+                                            [](const ChunkInfo &c)
+                                            { return !c.unchanged; });
+        writeU32(out, static_cast<uint32_t>(image.changedChunks));
+        for (size_t i = 0; i < image.chunks.size(); ++i)
+        {
+            if (image.chunks[i].unchanged)
+                continue;
+            writeU32(out, static_cast<uint32_t>(i));
+            writeU32(out, image.chunks[i].size);
+            out.write(reinterpret_cast<const char *>(changedData[i]->data()), changedData[i]->size());
+        }
+        if (!out)
+            throw std::runtime_error("Cannot write " + image.deltaFile);
+        image.deltaSize = static_cast<uint64_t>(out.tellp());
+    }
+}
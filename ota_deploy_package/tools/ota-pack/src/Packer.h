@@ -0,0 +1,85 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+#include <openssl/evp.h>
+#include "ThreadPool.h"
+
+struct PackOptions
+{
+    size_t chunkSize = 64 * 1024;
+    bool compress = false;
+    std::string baseDir; // Prior release images, matched to inputs by file name
+    std::string outDir = ".";
+    std::vector<uint8_t> kek; // Fleet key-encryption key (32 bytes); non-empty enables encryption
+};
+
+struct ChunkInfo
+{
+    uint64_t offset = 0;
+    uint32_t size = 0;
+    std::array<uint8_t, 32> sha256{};
+    std::vector<uint8_t> compressed;
+    bool unchanged = false; // Identical to the same chunk of the base image
+};
+
+struct PackedImage
+{
+    std::string name;
+    uint64_t size = 0;
+    std::array<uint8_t, 32> sha256{};
+    std::vector<uint8_t> signature;
+    std::vector<ChunkInfo> chunks;
+
+    std::string signatureFile;
+    std::string compressedFile;
+    uint64_t compressedSize = 0;
+
+    bool hasBase = false;
+    std::array<uint8_t, 32> baseSha256{};
+    std::string deltaFile;
+    uint64_t deltaSize = 0;
+    size_t changedChunks = 0;
+
+    // AES-256-CTR image under a fresh per-release key, wrapped with the KEK (RFC 3394)
+    std::string encryptedFile;
+    std::vector<uint8_t> wrappedKey;
+    std::array<uint8_t, 16> iv{};
+};
+
+// Streams each image once: the reader thread feeds the whole-image SHA-256
+// while chunk digests, compression and base comparison run on the shared pool.
+// The signature is RSA/ECDSA over the whole-image digest, which matches
+// crypto.createSign('RSA-SHA256') in signer.js and mbedtls_pk_verify on the device.
+// Encryption, when enabled, runs on the reader thread; digest and signature
+// always cover the plaintext.
+class Packer
+{
+public:
+    Packer(const std::string &privateKeyPath, const PackOptions &options, ThreadPool &pool);
+    ~Packer();
+
+    Packer(const Packer &) = delete;
+    Packer &operator=(const Packer &) = delete;
+
+    // Safe to call concurrently for different images.
+    PackedImage pack(const std::string &imagePath);
+
+    // Files pack() writes to the output directory for `imagePath`, all named after its file name
+    std::vector<std::string> artifactNames(const std::string &imagePath) const;
+
+private:
+    EVP_PKEY *key = nullptr;
+    PackOptions options;
+    ThreadPool &pool;
+
+    std::vector<std::array<uint8_t, 32>> hashBaseChunks(const std::string &basePath, std::array<uint8_t, 32> &baseSha256);
+    std::vector<uint8_t> sign(const std::array<uint8_t, 32> &digest);
+    void writeArtifacts(PackedImage &image, const std::vector<std::shared_ptr<std::vector<uint8_t>>> &changedData);
+};
+
+std::string toHex(const uint8_t *data, size_t len);
+std::string toBase64(const std::vector<uint8_t> &data);
@@ -0,0 +1,67 @@
+#pragma once
+
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <vector>
+
+// Fixed-size worker pool shared by every image being packed.
+class ThreadPool
+{
+public:
+    explicit ThreadPool(size_t threads)
+    {
+        for (size_t i = 0; i < threads; ++i)
+            workers.emplace_back([this]
+                                 { workerLoop(); });
+    }
+
+    ~ThreadPool()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        cv.notify_all();
+        for (auto &worker : workers)
+            worker.join();
+    }
+
+    void submit(std::function<void()> task)
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            tasks.push(std::move(task));
+        }
+        cv.notify_one();
+    }
+
+    size_t size() const { return workers.size(); }
+
+private:
+    void workerLoop()
+    {
+        while (true)
+        {
+            std::function<void()> task;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                cv.wait(lock, [this]
+                        { return stopping || !tasks.empty(); });
+                if (stopping && tasks.empty())
+                    return;
+                task = std::move(tasks.front());
+                tasks.pop();
+            }
+            task();
+        }
+    }
+
+    std::vector<std::thread> workers;
+    std::queue<std::function<void()>> tasks;
+    std::mutex mutex;
+    std::condition_variable cv;
+    bool stopping = false;
+};
@@ -0,0 +1,290 @@
+// ota-pack: builds signed, chunk-hashed (optionally compressed and delta) release
+// artifacts for one or more firmware images in a single pass each.
+//
+//   ota-pack --key=private.pem --version=1.2.3 [--out-dir=DIR] [--chunk-size=BYTES]
+//            [--compress] [--base-dir=DIR] [--jobs=N] [--encrypt-kek=FILE]
+//            image.bin [variant.bin ...]
+//
+// Writes <image.bin>.sig (raw signature, as signer.js did), optional <image.bin>.zc,
+// <image.bin>.delta and <image.bin>.enc, and one manifest.json describing every image.
+
+#include "Packer.h"
+#include "ThreadPool.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <exception>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <map>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+namespace
+{
+
+constexpr size_t kMaxChunkSize = 16 * 1024 * 1024;
+constexpr size_t kMaxJobs = 256;
+
+void usage()
+{
+    fprintf(stderr,
+            "Usage: ota-pack --key=<private.pem> --version=<x.y.z> [--out-dir=<dir>]\n"
+            "                [--chunk-size=<bytes>] [--compress] [--base-dir=<dir>] [--jobs=<n>]\n"
+            "                [--encrypt-kek=<32-byte key file>]\n"
+            "                <image.bin> [<variant.bin> ...]\n");
+}
+
+// Whole-string decimal in [1, max]; anything else is a usage error
+bool parseCount(const char *text, size_t max, size_t &out)
+{
+    if (*text < '0' || *text > '9')
+        return false;
+    char *end = nullptr;
+    errno = 0;
+    unsigned long long value = strtoull(text, &end, 10);
+    if (errno != 0 || *end != '\0' || value == 0 || value > max)
+        return false;
+    out = static_cast<size_t>(value);
+    return true;
+}
+
+// Version and file names come from the command line and may contain quotes or backslashes
+std::string jsonString(const std::string &value)
+{
+    std::string out = "\"";
+    for (unsigned char c : value)
+    {
+        switch (c)
+        {
+        case '"': out += "\\\""; break;
+        case '\\': out += "\\\\"; break;
+        case '\n': out += "\\n"; break;
+        case '\r': out += "\\r"; break;
+        case '\t': out += "\\t"; break;
+        default:
+            if (c < 0x20)
+            {
+                char escaped[8];
+                snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+                out += escaped;
+            }
+            else
+                out += static_cast<char>(c);
+        }
+    }
+    return out + "\"";
+}
+
+void writeManifest(const fs::path &path, const std::string &version, size_t chunkSize,
+                   const std::vector<PackedImage> &images)
+{
+    std::ofstream out(path);
+    out << "{\n  \"version\": " << jsonString(version) << ",\n"
+        << "  \"chunk_size\": " << chunkSize << ",\n"
+        << "  \"images\": [\n";
+
+    for (size_t i = 0; i < images.size(); ++i)
+    {
+        const PackedImage &img = images[i];
+        out << "    {\n"
+            << "      \"name\": " << jsonString(img.name) << ",\n"
+            << "      \"size\": " << img.size << ",\n"
+            << "      \"checksum\": \"" << toHex(img.sha256.data(), img.sha256.size()) << "\",\n"
+            << "      \"signature\": \"" << toBase64(img.signature) << "\",\n"
+            << "      \"signature_file\": " << jsonString(img.signatureFile) << ",\n";
+
+        if (!img.compressedFile.empty())
+        {
+            out << "      \"compression\": {\"format\": \"zlib-chunked\", \"file\": " << jsonString(img.compressedFile)
+                << ", \"size\": " << img.compressedSize << "},\n";
+        }
+        if (!img.encryptedFile.empty())
+        {
+            out << "      \"encryption\": {\"alg\": \"aes-256-ctr\", \"wrapped_key\": \"" << toBase64(img.wrappedKey)
+                << "\", \"iv\": \"" << toBase64(std::vector<uint8_t>(img.iv.begin(), img.iv.end()))
+                << "\", \"file\": " << jsonString(img.encryptedFile) << "},\n";
+        }
+        if (img.hasBase)
+        {
+            out << "      \"delta\": {\"base_checksum\": \"" << toHex(img.baseSha256.data(), img.baseSha256.size())
+                << "\", \"file\": " << jsonString(img.deltaFile) << ", \"size\": " << img.deltaSize
+                << ", \"changed_chunks\": " << img.changedChunks << "},\n";
+        }
+
+        out << "      \"chunks\": [\n";
+        for (size_t c = 0; c < img.chunks.size(); ++c)
+        {
+            const ChunkInfo &chunk = img.chunks[c];
+            out << "        {\"offset\": " << chunk.offset << ", \"size\": " << chunk.size
+                << ", \"sha256\": \"" << toHex(chunk.sha256.data(), chunk.sha256.size()) << "\"";
+            if (!chunk.compressed.empty())
+                out << ", \"compressed_size\": " << chunk.compressed.size();
+            if (img.hasBase)
+                out << ", \"unchanged\": " << (chunk.unchanged ? "true" : "false");
+            out << "}" << (c + 1 < img.chunks.size() ? "," : "") << "\n";
+        }
+        out << "      ]\n    }" << (i + 1 < images.size() ? "," : "") << "\n";
+    }
+    out << "  ]\n}\n";
+
+    if (!out)
+        throw std::runtime_error("Cannot write " + path.string());
+}
+
+std::vector<uint8_t> readKek(const std::string &path)
+{
+    std::ifstream in(path, std::ios::binary);
+    std::vector<uint8_t> kek((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+    if (!in.eof() && !in)
+        throw std::runtime_error("Cannot read " + path);
+    if (kek.size() != 32)
+        throw std::runtime_error("Key-encryption key must be 32 raw bytes: " + path);
+    return kek;
+}
+
+} // namespace
+
+int main(int argc, char **argv)
+{
+    std::string keyPath;
+    std::string version;
+    PackOptions options;
+    size_t jobs = std::max(1u, std::thread::hardware_concurrency());
+    std::vector<std::string> inputs;
+    std::string kekPath;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        std::string arg = argv[i];
+        auto value = [&](const char *prefix) -> const char *
+        {
+            size_t n = strlen(prefix);
+            return arg.compare(0, n, prefix) == 0 ? argv[i] + n : nullptr;
+        };
+
+        if (const char *v = value("--key="))
+            keyPath = v;
+        else if (const char *v = value("--version="))
+            version = v;
+        else if (const char *v = value("--out-dir="))
+            options.outDir = v;
+        else if (const char *v = value("--chunk-size="))
+        {
+            if (!parseCount(v, kMaxChunkSize, options.chunkSize))
+            {
+                fprintf(stderr, "Invalid --chunk-size: %s (1 to %zu bytes)\n", v, kMaxChunkSize);
+                usage();
+                return 1;
+            }
+        }
+        else if (const char *v = value("--base-dir="))
+            options.baseDir = v;
+        else if (const char *v = value("--jobs="))
+        {
+            if (!parseCount(v, kMaxJobs, jobs))
+            {
+                fprintf(stderr, "Invalid --jobs: %s (1 to %zu)\n", v, kMaxJobs);
+                usage();
+                return 1;
+            }
+        }
+        else if (const char *v = value("--encrypt-kek="))
+            kekPath = v;
+        else if (arg == "--compress")
+            options.compress = true;
+        else if (arg.compare(0, 2, "--") == 0)
+        {
+            fprintf(stderr, "Unknown option: %s\n", arg.c_str());
+            usage();
+            return 1;
+        }
+        else
+            inputs.push_back(arg);
+    }
+
+    if (keyPath.empty() || version.empty() || inputs.empty())
+    {
+        usage();
+        return 1;
+    }
+
+    try
+    {
+        auto start = std::chrono::steady_clock::now();
+        fs::create_directories(options.outDir);
+        if (!kekPath.empty())
+        {
+            // The compressed and delta artifacts would carry plaintext next to the encrypted image
+            if (options.compress || !options.baseDir.empty())
+                throw std::runtime_error("--encrypt-kek cannot be combined with --compress or --base-dir");
+            options.kek = readKek(kekPath);
+        }
+
+        ThreadPool pool(jobs);
+        Packer packer(keyPath, options, pool);
+
+        // Images are written concurrently; two writing the same file would corrupt both
+        std::map<std::string, std::string> producers;
+        for (const std::string &input : inputs)
+        {
+            for (const std::string &name : packer.artifactNames(input))
+            {
+                auto inserted = producers.emplace(name, input);
+                if (!inserted.second)
+                    throw std::runtime_error("Inputs " + inserted.first->second + " and " + input + " both produce " + name);
+            }
+        }
+
+        // One reader per image; the chunk work of all images shares the pool
+        std::vector<PackedImage> images(inputs.size());
+        std::vector<std::exception_ptr> errors(inputs.size());
+        std::vector<std::thread> readers;
+        for (size_t i = 0; i < inputs.size(); ++i)
+        {
+            readers.emplace_back([&, i]
+                                 {
+                                     try
+                                     {
+                                         images[i] = packer.pack(inputs[i]);
+                                     }
+                                     catch (...)
+                                     {
+                                         errors[i] = std::current_exception();
+                                     } });
+        }
+        for (auto &reader : readers)
+            reader.join();
+        for (auto &error : errors)
+        {
+            if (error)
+                std::rethrow_exception(error);
+        }
+
+        fs::path manifestPath = fs::path(options.outDir) / "manifest.json";
+        writeManifest(manifestPath, version, options.chunkSize, images);
+
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        for (const PackedImage &img : images)
+        {
+            printf("%s: %llu bytes, sha256 %s\n", img.name.c_str(), static_cast<unsigned long long>(img.size),
+                   toHex(img.sha256.data(), img.sha256.size()).c_str());
+        }
+        printf("Packed %zu image(s) with %zu threads in %.2f s -> %s\n", images.size(), pool.size(), seconds,
+               manifestPath.string().c_str());
+    }
+    catch (const std::exception &e)
+    {
+        fprintf(stderr, "ota-pack: %s\n", e.what());
+        return 1;
+    }
+    return 0;
+}